@@ -0,0 +1,116 @@
+#ifndef UTILITIES_ADAPTIVE_MUTEX_HPP
+#define UTILITIES_ADAPTIVE_MUTEX_HPP
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define UTILITIES_CPU_RELAX() _mm_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define UTILITIES_CPU_RELAX() __asm__ __volatile__("yield")
+#else
+#define UTILITIES_CPU_RELAX() ((void)0)
+#endif
+
+namespace Utilities
+{
+	/*!
+	* @brief Mutex for short critical sections: a contended lock() first spins for a while, expecting the owner to
+	* leave soon, and only then parks on the state word (a futex on Linux, WaitOnAddress on Windows, through
+	* std::atomic::wait). The spin budget adapts to how long previous acquisitions needed, like glibc's adaptive
+	* mutexes. Unlocking an uncontended mutex is one exchange, no system call.
+	* Satisfies Lockable and TimedLockable; it is not recursive.
+	*/
+	class adaptive_mutex
+	{
+	private:
+		static constexpr uint32_t _unlocked = 0;
+		static constexpr uint32_t _locked = 1;
+		static constexpr uint32_t _parked = 2;		// locked, and someone may be waiting in wait()
+		static constexpr int32_t _maxSpins = 1000;
+
+		std::atomic<uint32_t> _state = _unlocked;
+		std::atomic<int32_t> _spins = 100;			// running average of spins that led to success
+
+		bool _spin()
+		{
+			auto limit = std::min(_maxSpins, _spins.load(std::memory_order_relaxed) * 2 + 10);
+			for (int32_t i = 0; i < limit; ++i)
+			{
+				auto state = _state.load(std::memory_order_relaxed);
+				if (state == _unlocked && _state.compare_exchange_weak(state, _locked, std::memory_order_acquire, std::memory_order_relaxed))
+				{
+					_adapt(i);
+					return true;
+				}
+				if (state == _parked)
+					break;			// others are already sleeping, spinning would only delay them
+				UTILITIES_CPU_RELAX();
+			}
+			_adapt(limit);
+			return false;
+		}
+		void _adapt(int32_t spins)
+		{
+			auto average = _spins.load(std::memory_order_relaxed);
+			_spins.store(average + (spins - average) / 8, std::memory_order_relaxed);
+		}
+	public:
+		adaptive_mutex() = default;
+		adaptive_mutex(const adaptive_mutex& rhs) = delete;
+		adaptive_mutex& operator=(const adaptive_mutex& rhs) = delete;
+
+		void lock()
+		{
+			auto expected = _unlocked;
+			if (_state.compare_exchange_strong(expected, _locked, std::memory_order_acquire, std::memory_order_relaxed))
+				return;
+			if (_spin())
+				return;
+			// from here on the state stays _parked while we own it, so our unlock() wakes the next waiter
+			while (_state.exchange(_parked, std::memory_order_acquire) != _unlocked)
+				_state.wait(_parked, std::memory_order_relaxed);
+		}
+		bool try_lock()
+		{
+			auto expected = _unlocked;
+			return _state.compare_exchange_strong(expected, _locked, std::memory_order_acquire, std::memory_order_relaxed);
+		}
+		void unlock()
+		{
+			if (_state.exchange(_unlocked, std::memory_order_release) == _parked)
+				_state.notify_one();
+		}
+
+		/*!
+		* @brief std::atomic::wait has no timeout, so timed attempts poll with growing sleeps after the spin phase.
+		*/
+		template<typename TClock, typename TDuration>
+		bool try_lock_until(std::chrono::time_point<TClock, TDuration> const& deadline)
+		{
+			if (try_lock() || _spin())
+				return true;
+			auto pause = std::chrono::microseconds(1);
+			while (!try_lock())
+			{
+				auto now = TClock::now();
+				if (now >= deadline)
+					return false;
+				std::this_thread::sleep_for(std::min<typename TClock::duration>(pause, deadline - now));
+				pause = std::min(pause * 2, std::chrono::microseconds(1000));
+			}
+			return true;
+		}
+		template<typename TRep, typename TPeriod>
+		bool try_lock_for(std::chrono::duration<TRep, TPeriod> const& timeout)
+		{
+			return try_lock_until(std::chrono::steady_clock::now() + timeout);
+		}
+	};
+}
+
+#endif //UTILITIES_ADAPTIVE_MUTEX_HPP
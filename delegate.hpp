@@ -0,0 +1,223 @@
+#ifndef UTILITIES_DELEGATE_HPP
+#define UTILITIES_DELEGATE_HPP
+
+#include <new>
+#include <cstddef>
+#include <concepts>
+#include <utility>
+#include <functional>
+#include <type_traits>
+
+namespace Utilities
+{
+	template<typename TSignature, size_t InlineSize = 4 * sizeof(void*), bool Copyable = true>
+	class Delegate;
+
+	/*!
+	* @brief Type-erased callable like std::function, with a small buffer of InlineSize bytes.
+	* Targets that fit the buffer and are nothrow-movable are stored inline, larger ones on the heap.
+	* With Copyable = false the delegate is move-only and accepts move-only targets.
+	* Two delegates compare equal when they hold the same equality-comparable target (function pointers,
+	* bind<&T::member>(object)) with equal values; lambdas never compare equal.
+	*/
+	template<typename TResult, typename ... TArgs, size_t InlineSize, bool Copyable>
+	class Delegate<TResult(TArgs...), InlineSize, Copyable>
+	{
+		static_assert(InlineSize >= sizeof(void*), "the inline buffer must hold at least a pointer");
+	private:
+		struct _operations
+		{
+			TResult (*Invoke)(void* storage, TArgs&&... args);
+			void (*Move)(void* to, void* from) noexcept;		// move-constructs into `to` and destroys `from`
+			void (*Copy)(void* to, const void* from);
+			void (*Destroy)(void* storage) noexcept;
+			bool (*Equal)(const void* lhs, const void* rhs);	// null when the target is not comparable
+		};
+
+		template<typename TTarget>
+		static constexpr bool _inline = sizeof(TTarget) <= InlineSize
+			&& alignof(TTarget) <= alignof(std::max_align_t)
+			&& std::is_nothrow_move_constructible_v<TTarget>;
+
+		template<typename TTarget>
+		struct _storage
+		{
+			static TTarget& get(void* s)
+			{
+				if constexpr (_inline<TTarget>)
+					return *std::launder(reinterpret_cast<TTarget*>(s));
+				else
+					return **reinterpret_cast<TTarget**>(s);
+			}
+			static const TTarget& get(const void* s) { return get(const_cast<void*>(s)); }
+
+			template<typename TValue>
+			static void create(void* s, TValue&& value)
+			{
+				if constexpr (_inline<TTarget>)
+					::new (s) TTarget(std::forward<TValue>(value));
+				else
+					*reinterpret_cast<TTarget**>(s) = new TTarget(std::forward<TValue>(value));
+			}
+
+			static TResult invoke(void* s, TArgs&&... args)
+			{
+				if constexpr (std::is_void_v<TResult>)
+					std::invoke(get(s), std::forward<TArgs>(args)...);
+				else
+					return std::invoke(get(s), std::forward<TArgs>(args)...);
+			}
+			static void move(void* to, void* from) noexcept
+			{
+				if constexpr (_inline<TTarget>)
+				{
+					::new (to) TTarget(std::move(get(from)));
+					get(from).~TTarget();
+				}
+				else
+					*reinterpret_cast<TTarget**>(to) = *reinterpret_cast<TTarget**>(from);
+			}
+			static void copy(void* to, const void* from) requires Copyable { create(to, get(from)); }
+			static void destroy(void* s) noexcept
+			{
+				if constexpr (_inline<TTarget>)
+					get(s).~TTarget();
+				else
+					delete *reinterpret_cast<TTarget**>(s);
+			}
+			static bool equal(const void* lhs, const void* rhs) requires std::equality_comparable<TTarget> { return get(lhs) == get(rhs); }
+
+			static constexpr _operations make_operations()
+			{
+				_operations ops { &invoke, &move, nullptr, &destroy, nullptr };
+				if constexpr (Copyable)
+					ops.Copy = &copy;
+				if constexpr (std::equality_comparable<TTarget>)
+					ops.Equal = &equal;
+				return ops;
+			}
+			static constexpr _operations operations = make_operations();
+		};
+
+		// target of bind<Member>(object): just the object pointer
+		template<auto Member, typename TObject>
+		struct _bound
+		{
+			TObject* Object;
+
+			TResult operator()(TArgs&&... args) const
+			{
+				if constexpr (std::is_void_v<TResult>)
+					std::invoke(Member, Object, std::forward<TArgs>(args)...);
+				else
+					return std::invoke(Member, Object, std::forward<TArgs>(args)...);
+			}
+			bool operator==(_bound const& rhs) const = default;
+		};
+
+		alignas(std::max_align_t) mutable unsigned char _buffer[InlineSize];
+		const _operations* _ops = nullptr;
+
+		void _reset() noexcept
+		{
+			if (_ops)
+				_ops->Destroy(_buffer);
+			_ops = nullptr;
+		}
+	public:
+		using result_type = TResult;
+		static constexpr size_t inline_size = InlineSize;
+
+		Delegate() noexcept = default;
+		Delegate(std::nullptr_t) noexcept {}
+
+		template<typename TCallable>
+			requires (!std::is_same_v<std::remove_cvref_t<TCallable>, Delegate>)
+				&& std::is_invocable_r_v<TResult, std::decay_t<TCallable>&, TArgs...>
+		Delegate(TCallable&& callable)
+		{
+			using target_type = std::decay_t<TCallable>;
+			static_assert(!Copyable || std::is_copy_constructible_v<target_type>, "a copyable Delegate needs a copyable target, use Copyable = false");
+			// a function passed by reference decays to a pointer that cannot be null
+			if constexpr (std::is_pointer_v<std::remove_cvref_t<TCallable>> || std::is_member_pointer_v<std::remove_cvref_t<TCallable>>)
+				if (callable == nullptr)
+					return;
+			_storage<target_type>::create(_buffer, std::forward<TCallable>(callable));
+			_ops = &_storage<target_type>::operations;
+		}
+
+		/*!
+		* @brief Calls `Member` on `object` without allocating; equal to any other bind of the same member and object.
+		*/
+		template<auto Member, typename TObject>
+		static Delegate bind(TObject& object)
+		{
+			return Delegate(_bound<Member, TObject> { &object });
+		}
+
+		Delegate(const Delegate& other) requires Copyable
+		{
+			if (other._ops)
+			{
+				other._ops->Copy(_buffer, other._buffer);
+				_ops = other._ops;
+			}
+		}
+		Delegate(Delegate&& other) noexcept
+		{
+			if (other._ops)
+			{
+				other._ops->Move(_buffer, other._buffer);
+				_ops = std::exchange(other._ops, nullptr);
+			}
+		}
+		Delegate& operator=(const Delegate& other) requires Copyable
+		{
+			if (this != &other)
+			{
+				Delegate copy { other };
+				*this = std::move(copy);
+			}
+			return *this;
+		}
+		Delegate& operator=(Delegate&& other) noexcept
+		{
+			if (this != &other)
+			{
+				_reset();
+				if (other._ops)
+				{
+					other._ops->Move(_buffer, other._buffer);
+					_ops = std::exchange(other._ops, nullptr);
+				}
+			}
+			return *this;
+		}
+		Delegate& operator=(std::nullptr_t) noexcept { _reset(); return *this; }
+		~Delegate() { _reset(); }
+
+		TResult operator()(TArgs... args) const
+		{
+			if (!_ops)
+				throw std::bad_function_call();
+			return _ops->Invoke(_buffer, std::forward<TArgs>(args)...);
+		}
+
+		explicit operator bool() const noexcept { return _ops != nullptr; }
+
+		bool operator==(const Delegate& rhs) const
+		{
+			if (_ops != rhs._ops)
+				return false;
+			if (!_ops)
+				return true;
+			return _ops->Equal && _ops->Equal(_buffer, rhs._buffer);
+		}
+		bool operator==(std::nullptr_t) const noexcept { return _ops == nullptr; }
+	};
+
+	template<typename TSignature, size_t InlineSize = 4 * sizeof(void*)>
+	using MoveDelegate = Delegate<TSignature, InlineSize, false>;
+}
+
+#endif //UTILITIES_DELEGATE_HPP
@@ -0,0 +1,66 @@
+#ifndef UTILITIES_EVENT_COUNT_HPP
+#define UTILITIES_EVENT_COUNT_HPP
+
+#include <atomic>
+#include <cstdint>
+
+namespace Utilities::Threading
+{
+	/*!
+	* @brief Event count: lets a consumer sleep until a lock-free structure changes, without producers taking a lock.
+	* The consumer calls prepare_wait(), checks its condition again, then either cancel_wait() or wait(key).
+	* Producers publish their change, then notify; the notify is a fence and a load unless someone is waiting,
+	* only then does it bump the epoch and wake through std::atomic::wait (a futex on Linux).
+	*/
+	class EventCount
+	{
+	public:
+		using key_type = uint32_t;
+	private:
+		alignas(64) std::atomic<uint32_t> _epoch = 0;
+		std::atomic<uint32_t> _waiters = 0;
+
+		bool _signal()
+		{
+			// orders the producer's publication before the check, pairs with the fence in prepare_wait()
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (_waiters.load(std::memory_order_relaxed) == 0)
+				return false;
+			_epoch.fetch_add(1, std::memory_order_release);
+			return true;
+		}
+	public:
+		EventCount() = default;
+		EventCount(const EventCount& rhs) = delete;
+		EventCount& operator=(const EventCount& rhs) = delete;
+
+		key_type prepare_wait()
+		{
+			_waiters.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			return _epoch.load(std::memory_order_acquire);
+		}
+		void cancel_wait() { _waiters.fetch_sub(1, std::memory_order_relaxed); }
+		/*!
+		* @brief Sleeps unless a notify happened since prepare_wait() returned `key`.
+		*/
+		void wait(key_type key)
+		{
+			_epoch.wait(key, std::memory_order_acquire);
+			_waiters.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		void notify_one()
+		{
+			if (_signal())
+				_epoch.notify_one();
+		}
+		void notify_all()
+		{
+			if (_signal())
+				_epoch.notify_all();
+		}
+	};
+}
+
+#endif //UTILITIES_EVENT_COUNT_HPP
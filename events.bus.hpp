@@ -0,0 +1,290 @@
+#ifndef UTILITIES_EVENTS_BUS_HPP
+#define UTILITIES_EVENTS_BUS_HPP
+
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+#include <exception>
+#include <functional>
+#include <type_traits>
+
+#include "events.hpp"
+#include "mpsc_queue.hpp"
+
+namespace Utilities
+{
+	enum class EventDelivery
+	{
+		sync,			// on the publishing thread, inside publish()
+		async,			// every event, in publish order, on the topic's dispatcher thread
+		coalesced		// on the dispatcher thread, only the latest event published since the last delivery
+	};
+
+	enum class EventPriority { normal, high };
+
+	/*!
+	* @brief Asynchronous event bus. Each topic is an Event whose async subscribers are fed from a lock-free queue by one
+	* of the bus's dispatcher threads, so publish() costs a queue push no matter how slow the subscribers are.
+	* Topics are owned by the bus and pinned to one dispatcher, which keeps their events ordered. A dispatcher
+	* delivers at most BatchSize events of a topic per visit and serves high priority topics first.
+	*/
+	class EventBus
+	{
+	private:
+		struct _dispatcher;
+
+		struct _topic_base
+		{
+			EventBus* Bus;
+			_dispatcher* Dispatcher;
+			EventPriority Priority;
+			std::atomic<size_t> Work = 0;	// queued events plus an occupied coalesced slot
+
+			_topic_base(EventBus* bus, _dispatcher* dispatcher, EventPriority priority) :
+				Bus(bus), Dispatcher(dispatcher), Priority(priority)
+			{}
+			virtual ~_topic_base() = default;
+
+			// delivers up to `batch` events, returns how many were taken
+			virtual size_t drain(size_t batch) = 0;
+
+			// called after making one unit of work visible; the first one hands the topic to its dispatcher
+			void added()
+			{
+				if (Work.fetch_add(1, std::memory_order_acq_rel) == 0)
+					Bus->_schedule(*this);
+			}
+		};
+
+		struct _dispatcher
+		{
+			Threading::MpscQueue<_topic_base*> Ready[2];	// indexed by EventPriority
+			alignas(64) std::atomic<uint32_t> Signal = 0;
+			std::thread Thread;
+		};
+
+		std::vector<std::unique_ptr<_dispatcher>> _dispatchers;
+		std::map<std::string, std::unique_ptr<_topic_base>, std::less<>> _topics;
+		std::mutex _topicsMutex;
+		size_t _batchSize;
+		std::atomic<bool> _stop = false;
+		alignas(64) std::atomic<int64_t> _pending = 0;
+
+		void _schedule(_topic_base& topic)
+		{
+			auto& d = *topic.Dispatcher;
+			d.Ready[static_cast<size_t>(topic.Priority)].push(&topic);
+			d.Signal.fetch_add(1, std::memory_order_release);
+			d.Signal.notify_one();
+		}
+
+		// _pending is raised before an event becomes visible and lowered after delivery, so it never undercounts
+		void _delivered(size_t count)
+		{
+			if (count > 0 && _pending.fetch_sub(static_cast<int64_t>(count), std::memory_order_acq_rel) == static_cast<int64_t>(count))
+				_pending.notify_all();
+		}
+
+		void _visit(_topic_base& topic)
+		{
+			size_t taken = topic.drain(_batchSize);
+			_delivered(taken);
+			// still owned by this dispatcher while Work is non-zero: requeue behind the other topics.
+			// drain() may take an event whose added() has not run yet, the wrap-around evens out once it does.
+			if (topic.Work.fetch_sub(taken, std::memory_order_acq_rel) != taken)
+				topic.Dispatcher->Ready[static_cast<size_t>(topic.Priority)].push(&topic);
+		}
+
+		void _run(_dispatcher& d)
+		{
+			while (true)
+			{
+				auto seen = d.Signal.load(std::memory_order_acquire);
+				while (true)
+				{
+					auto topic = d.Ready[static_cast<size_t>(EventPriority::high)].pop();
+					if (!topic)
+						topic = d.Ready[static_cast<size_t>(EventPriority::normal)].pop();
+					if (!topic)
+						break;
+					_visit(**topic);
+				}
+				if (_stop.load(std::memory_order_acquire))
+					return;
+				d.Signal.wait(seen, std::memory_order_acquire);
+			}
+		}
+
+		void _report(std::exception_ptr error)
+		{
+			try { Errors(error); }
+			catch (...) {}
+		}
+	public:
+		template<typename ... TArgs>
+		class Topic : public _topic_base
+		{
+		public:
+			using CallbackType = typename Event<TArgs...>::CallbackType;
+			using value_type = std::tuple<std::decay_t<TArgs>...>;
+		private:
+			static constexpr unsigned _deliveryShift = 62;
+			static constexpr uint64_t _idMask = (uint64_t(1) << _deliveryShift) - 1;
+
+			Event<TArgs...> _events[3];		// indexed by EventDelivery
+			Threading::MpscQueue<value_type> _queue;
+			std::atomic<value_type*> _latest = nullptr;
+
+			Event<TArgs...>& _event(EventDelivery delivery) { return _events[static_cast<size_t>(delivery)]; }
+
+			size_t drain(size_t batch) override
+			{
+				size_t taken = 0;
+				auto& async = _event(EventDelivery::async);
+				for (; taken < batch; ++taken)
+				{
+					auto item = _queue.pop();
+					if (!item)
+						break;
+					try { std::apply(async, *item); }
+					catch (...) { Bus->_report(std::current_exception()); }
+				}
+				if (std::unique_ptr<value_type> latest { _latest.exchange(nullptr, std::memory_order_acq_rel) })
+				{
+					++taken;
+					try { std::apply(_event(EventDelivery::coalesced), *latest); }
+					catch (...) { Bus->_report(std::current_exception()); }
+				}
+				return taken;
+			}
+		public:
+			Topic(EventBus* bus, _dispatcher* dispatcher, EventPriority priority) :
+				_topic_base(bus, dispatcher, priority)
+			{}
+			~Topic() override { delete _latest.load(std::memory_order_relaxed); }
+
+			/*!
+			* @brief Async subscribers see every event published after they subscribed; coalesced ones may miss intermediate values.
+			*/
+			EventToken subscribe(CallbackType callback, EventDelivery delivery = EventDelivery::async)
+			{
+				auto token = _event(delivery).subscribe(std::move(callback));
+				token.Id |= static_cast<uint64_t>(delivery) << _deliveryShift;
+				return token;
+			}
+			bool unsubscribe(EventToken token)
+			{
+				auto delivery = token.Id >> _deliveryShift;
+				if (delivery > static_cast<uint64_t>(EventDelivery::coalesced))
+					return false;		// not a token of this topic
+				return _event(static_cast<EventDelivery>(delivery)).unsubscribe(EventToken { token.Id & _idMask });
+			}
+			EventToken operator+=(CallbackType callback) { return subscribe(std::move(callback)); }
+			bool operator-=(EventToken token) { return unsubscribe(token); }
+
+			void publish(TArgs... args)
+			{
+				auto& sync = _event(EventDelivery::sync);
+				if (!sync.empty())
+					sync(args...);
+				if (!_event(EventDelivery::async).empty())
+				{
+					Bus->_pending.fetch_add(1, std::memory_order_relaxed);
+					_queue.push(args...);
+					added();
+				}
+				if (!_event(EventDelivery::coalesced).empty())
+				{
+					Bus->_pending.fetch_add(1, std::memory_order_relaxed);
+					auto previous = _latest.exchange(new value_type(args...), std::memory_order_acq_rel);
+					if (previous)
+					{
+						// superseded, the slot was already counted as work
+						delete previous;
+						Bus->_delivered(1);
+					}
+					else
+						added();
+				}
+			}
+			void operator()(TArgs... args) { publish(args...); }
+		};
+
+		/*!
+		* @brief Raised on a dispatcher thread when an async or coalesced subscriber throws.
+		*/
+		Event<std::exception_ptr> Errors;
+
+		EventBus(size_t dispatchers = 1, size_t batchSize = 64) :
+			_batchSize(batchSize == 0 ? 1 : batchSize)
+		{
+			if (dispatchers == 0)
+				dispatchers = 1;
+			_dispatchers.reserve(dispatchers);
+			for (size_t i = 0; i < dispatchers; ++i)
+			{
+				auto& d = *_dispatchers.emplace_back(std::make_unique<_dispatcher>());
+				d.Thread = std::thread(&EventBus::_run, this, std::ref(d));
+			}
+		}
+		EventBus(const EventBus& rhs) = delete;
+		EventBus(EventBus&& rhs) = delete;
+		/*!
+		* @brief Delivers what is already queued, then joins the dispatchers. Nothing may publish concurrently.
+		*/
+		~EventBus()
+		{
+			_stop.store(true, std::memory_order_release);
+			for (auto& d : _dispatchers)
+			{
+				d->Signal.fetch_add(1, std::memory_order_release);
+				d->Signal.notify_one();
+			}
+			for (auto& d : _dispatchers)
+				d->Thread.join();
+		}
+
+		/*!
+		* @brief Topic by name, created on first use. Topics live as long as the bus, so the reference can be kept.
+		* @throws std::invalid_argument when the name is already used with other argument types.
+		*/
+		template<typename ... TArgs>
+		Topic<TArgs...>& topic(std::string_view name, EventPriority priority = EventPriority::normal)
+		{
+			std::lock_guard lk { _topicsMutex };
+			auto it = _topics.find(name);
+			if (it == _topics.end())
+			{
+				auto& d = *_dispatchers[std::hash<std::string_view>{}(name) % _dispatchers.size()];
+				it = _topics.emplace(std::string(name), std::make_unique<Topic<TArgs...>>(this, &d, priority)).first;
+			}
+			auto typed = dynamic_cast<Topic<TArgs...>*>(it->second.get());
+			if (!typed)
+				throw std::invalid_argument("EventBus: topic " + std::string(name) + " has different argument types");
+			return *typed;
+		}
+
+		/*!
+		* @brief Blocks until nothing is pending, i.e. every event published before the call has been delivered
+		* (or superseded, for coalesced subscribers). With concurrent publishers it also waits for their events.
+		* Must not be called from a subscriber running on a dispatcher.
+		*/
+		void flush()
+		{
+			for (auto pending = _pending.load(std::memory_order_acquire); pending > 0; pending = _pending.load(std::memory_order_acquire))
+				_pending.wait(pending, std::memory_order_acquire);
+		}
+
+		size_t dispatchers() const { return _dispatchers.size(); }
+		size_t pending() const { return static_cast<size_t>(std::max<int64_t>(_pending.load(std::memory_order_relaxed), 0)); }
+	};
+}
+
+#endif //UTILITIES_EVENTS_BUS_HPP
@@ -1,39 +1,289 @@
 ﻿#ifndef UTILITIES_EVENTS_HPP
 #define UTILITIES_EVENTS_HPP
 
-#include <list>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
 #include <functional>
 
+#include "delegate.hpp"
+
 namespace Utilities
 {
+	/*!
+	* @brief Identifies one subscription, returned by operator+= and passed to operator-=.
+	*/
+	struct EventToken
+	{
+		uint64_t Id = 0;
+
+		explicit operator bool() const { return Id != 0; }
+		bool operator==(EventToken const& rhs) const = default;
+	};
+
+	namespace _events
+	{
+		/*!
+		* @brief Copy-on-write subscriber list.
+		* Dispatch loads an immutable snapshot vector and takes no lock: it only bumps the reader counter of the current epoch.
+		* Writers serialize on a mutex, publish a new snapshot and retire the old one, which is deleted once two epoch flips
+		* have each seen their reader counter drain. Reclamation never waits, so a callback may subscribe or unsubscribe
+		* from inside a dispatch; retired snapshots are freed on a later write or on destruction.
+		*/
+		template<typename TCallback>
+		class subscriber_list
+		{
+		public:
+			struct entry
+			{
+				uint64_t Id;
+				TCallback Callback;
+			};
+			using snapshot_type = std::vector<entry>;	// ordered by Id
+		private:
+			struct alignas(64) _counter
+			{
+				std::atomic<size_t> Value = 0;
+			};
+			struct _retired_snapshot
+			{
+				const snapshot_type* Snapshot;
+				uint64_t Step;		// flips started before it was retired
+			};
+
+			std::atomic<const snapshot_type*> _snapshot = nullptr;
+			std::atomic<unsigned> _epoch = 0;
+			mutable _counter _readers[2];
+
+			mutable std::mutex _mutex;
+			uint64_t _nextId = 1;
+			std::vector<_retired_snapshot> _retired;
+			uint64_t _started = 0;
+			uint64_t _completed = 0;
+			bool _flipping = false;
+			unsigned _draining = 0;
+
+			// _mutex must be held
+			void _reclaim()
+			{
+				while (!_retired.empty())
+				{
+					if (_flipping)
+					{
+						if (_readers[_draining].Value.load(std::memory_order_seq_cst) != 0)
+							break;
+						_flipping = false;
+						++_completed;
+					}
+					std::erase_if(_retired, [this](_retired_snapshot const& r)
+					{
+						if (r.Step + 2 > _completed)
+							return false;
+						delete r.Snapshot;
+						return true;
+					});
+					if (_retired.empty())
+						break;
+
+					unsigned epoch = _epoch.load(std::memory_order_relaxed);
+					_epoch.store(epoch ^ 1, std::memory_order_seq_cst);
+					_draining = epoch;
+					_flipping = true;
+					++_started;
+				}
+			}
+			void _publish(const snapshot_type* next, const snapshot_type* previous)
+			{
+				_snapshot.store(next, std::memory_order_seq_cst);
+				if (previous)
+					_retired.push_back({ previous, _started });
+				_reclaim();
+			}
+		public:
+			subscriber_list() = default;
+			subscriber_list(subscriber_list const& other)
+			{
+				std::lock_guard lk { other._mutex };
+				if (auto s = other._snapshot.load(std::memory_order_relaxed))
+					_snapshot.store(new snapshot_type(*s), std::memory_order_relaxed);
+				_nextId = other._nextId;
+			}
+			subscriber_list(subscriber_list&& other) noexcept
+			{
+				std::lock_guard lk { other._mutex };
+				_snapshot.store(other._snapshot.exchange(nullptr), std::memory_order_relaxed);
+				_nextId = other._nextId;
+			}
+			subscriber_list& operator=(subscriber_list const& other)
+			{
+				if (this == &other)
+					return *this;
+				const snapshot_type* copy = nullptr;
+				{
+					std::lock_guard lk { other._mutex };
+					if (auto s = other._snapshot.load(std::memory_order_relaxed))
+						copy = new snapshot_type(*s);
+				}
+				std::lock_guard lk { _mutex };
+				_nextId = (std::max)(_nextId, other._nextId);
+				_publish(copy, _snapshot.load(std::memory_order_relaxed));
+				return *this;
+			}
+			subscriber_list& operator=(subscriber_list&& other) noexcept
+			{
+				if (this == &other)
+					return *this;
+				const snapshot_type* stolen;
+				{
+					std::lock_guard lk { other._mutex };
+					stolen = other._snapshot.exchange(nullptr);
+				}
+				std::lock_guard lk { _mutex };
+				_nextId = (std::max)(_nextId, other._nextId);
+				_publish(stolen, _snapshot.load(std::memory_order_relaxed));
+				return *this;
+			}
+			// no dispatch may be running
+			~subscriber_list()
+			{
+				delete _snapshot.load(std::memory_order_relaxed);
+				for (auto& r : _retired)
+					delete r.Snapshot;
+			}
+
+			EventToken add(TCallback callback)
+			{
+				std::lock_guard lk { _mutex };
+				auto previous = _snapshot.load(std::memory_order_relaxed);
+				auto next = new snapshot_type();
+				next->reserve((previous ? previous->size() : 0) + 1);
+				if (previous)
+					next->insert(next->end(), previous->begin(), previous->end());
+				EventToken token { _nextId++ };
+				next->push_back({ token.Id, std::move(callback) });
+				_publish(next, previous);
+				return token;
+			}
+			bool remove(EventToken token)
+			{
+				std::lock_guard lk { _mutex };
+				auto previous = _snapshot.load(std::memory_order_relaxed);
+				if (!previous)
+					return false;
+				auto it = std::lower_bound(previous->begin(), previous->end(), token.Id,
+					[](entry const& e, uint64_t id) { return e.Id < id; });
+				if (it == previous->end() || it->Id != token.Id)
+					return false;
+
+				snapshot_type* next = nullptr;
+				if (previous->size() > 1)
+				{
+					next = new snapshot_type();
+					next->reserve(previous->size() - 1);
+					next->insert(next->end(), previous->begin(), it);
+					next->insert(next->end(), it + 1, previous->end());
+				}
+				_publish(next, previous);
+				return true;
+			}
+			/*!
+			* @brief Removes the first subscriber whose callback compares equal.
+			*/
+			bool remove(TCallback const& callback)
+			{
+				uint64_t id = 0;
+				{
+					std::lock_guard lk { _mutex };
+					auto s = _snapshot.load(std::memory_order_relaxed);
+					if (!s)
+						return false;
+					auto it = std::find_if(s->begin(), s->end(), [&callback](entry const& e) { return e.Callback == callback; });
+					if (it == s->end())
+						return false;
+					id = it->Id;
+				}
+				// ids are never reused, so the entry is either still there or already gone
+				return remove(EventToken { id });
+			}
+			void clear()
+			{
+				std::lock_guard lk { _mutex };
+				_publish(nullptr, _snapshot.load(std::memory_order_relaxed));
+			}
+
+			size_t size() const
+			{
+				auto s = _snapshot.load(std::memory_order_acquire);
+				return s ? s->size() : 0;
+			}
+
+			/*!
+			* @brief Invokes callable(callback) for every subscriber of the current snapshot.
+			*/
+			template<typename TCallable>
+			void for_each(TCallable&& callable) const
+			{
+				if (_snapshot.load(std::memory_order_relaxed) == nullptr)
+					return;
+
+				auto& readers = _readers[_epoch.load(std::memory_order_seq_cst)].Value;
+				readers.fetch_add(1, std::memory_order_seq_cst);
+				struct leave
+				{
+					std::atomic<size_t>& Readers;
+					~leave() { Readers.fetch_sub(1, std::memory_order_release); }
+				} guard { readers };
+
+				if (auto s = _snapshot.load(std::memory_order_seq_cst))
+					for (auto& e : *s)
+						callable(e.Callback);
+			}
+		};
+	}
+
+	/*!
+	* @brief Multicast callback list. Dispatching takes no lock and may run concurrently with subscribing,
+	* unsubscribing and other dispatches; each dispatch sees the subscribers as of its start.
+	*/
 	template<typename ... TArgs>
 	class Event
 	{
 	public:
-		using CallbackType = std::function<void(TArgs... args)>;
+		using CallbackType = Delegate<void(TArgs... args)>;
 	private:
-		std::list<CallbackType> _callbacks;
+		_events::subscriber_list<CallbackType> _callbacks;
 	public:
 		Event() = default;
-		~Event() { _callbacks.clear(); }
 
 		void operator()(TArgs... args) const
 		{
-			for (auto& callback : _callbacks)
-				callback(args);
+			_callbacks.for_each([&](CallbackType const& callback) { callback(args...); });
 		}
-		void operator+=(CallbackType callback) { _callbacks.push_back(callback); }
-		void operator-=(CallbackType callback) { _callbacks.remove(callback); }
+		EventToken operator+=(CallbackType callback) { return _callbacks.add(std::move(callback)); }
+		bool operator-=(EventToken token) { return _callbacks.remove(token); }
+		/*!
+		* @brief Only finds comparable callbacks, e.g. CallbackType::bind<&T::member>(object) or a function pointer.
+		*/
+		bool operator-=(CallbackType const& callback) { return _callbacks.remove(callback); }
+
+		EventToken subscribe(CallbackType callback) { return _callbacks.add(std::move(callback)); }
+		bool unsubscribe(EventToken token) { return _callbacks.remove(token); }
+		void clear() { _callbacks.clear(); }
+		size_t size() const { return _callbacks.size(); }
+		bool empty() const { return _callbacks.size() == 0; }
 	};
 
 	template<typename TObject, typename ... TArgs>
 	class ObjectEvent
 	{
 	public:
-		using CallbackType = std::function<void(TObject& sender, TArgs... args)>;
+		using CallbackType = Delegate<void(TObject& sender, TArgs... args)>;
 	private:
 		TObject* _sender;
-		std::list<CallbackType> _callbacks;
+		_events::subscriber_list<CallbackType> _callbacks;
 	public:
 		ObjectEvent(TObject* sender) :
 			_sender(sender)
@@ -42,36 +292,43 @@ namespace Utilities
 			_sender(&sender)
 		{ }
 
-		ObjectEvent(ObjectEvent const& other) noexcept :
+		ObjectEvent(ObjectEvent const& other) :
 			_sender(other._sender), _callbacks(other._callbacks) { }
-		ObjectEvent& operator=(ObjectEvent const& other) noexcept
+		ObjectEvent& operator=(ObjectEvent const& other)
 		{
 			_sender = other._sender;
-			_callbacks = other._callbacks;;
+			_callbacks = other._callbacks;
 			return *this;
 		}
 
 		ObjectEvent(ObjectEvent&& other) noexcept :
 			_sender(std::exchange(other._sender, nullptr)),
-			_callbacks(std::exchange(other._callbacks, {})) { }
+			_callbacks(std::move(other._callbacks)) { }
 		ObjectEvent& operator=(ObjectEvent&& other) noexcept
 		{
 			_sender = std::exchange(other._sender, nullptr);
-			_callbacks = std::exchange(other._callbacks, {});
+			_callbacks = std::move(other._callbacks);
 			return *this;
 		}
 
-		~ObjectEvent() { _callbacks.clear(); }
-
 		void operator()(TArgs... args) const
 		{
-			TObject& sender = (TObject&) _sender;
-			for (auto& callback : _callbacks)
-				callback(sender, args...);
+			TObject& sender = *_sender;
+			_callbacks.for_each([&](CallbackType const& callback) { callback(sender, args...); });
 		}
-		void operator+=(CallbackType callback) { _callbacks.push_back(callback); }
-		void operator-=(CallbackType callback) { _callbacks.remove(callback); }
+		EventToken operator+=(CallbackType callback) { return _callbacks.add(std::move(callback)); }
+		bool operator-=(EventToken token) { return _callbacks.remove(token); }
+		/*!
+		* @brief Only finds comparable callbacks, e.g. CallbackType::bind<&T::member>(object) or a function pointer.
+		*/
+		bool operator-=(CallbackType const& callback) { return _callbacks.remove(callback); }
+
+		EventToken subscribe(CallbackType callback) { return _callbacks.add(std::move(callback)); }
+		bool unsubscribe(EventToken token) { return _callbacks.remove(token); }
+		void clear() { _callbacks.clear(); }
+		size_t size() const { return _callbacks.size(); }
+		bool empty() const { return _callbacks.size() == 0; }
 	};
 }
 
-#endif // UTILITIES_EVENTS_HPP
\ No newline at end of file
+#endif // UTILITIES_EVENTS_HPP
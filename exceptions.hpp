@@ -63,6 +63,13 @@ namespace Exceptions
 		file_not_found_error(const std::string& function, const std::string& file, int line, std::string_view const& filename) : base_error("File (" + std::string(filename) + ") not found", function, file, line), FileName(filename) {}
 		file_not_found_error(const std::string& msg, const std::string& function, std::string file, int line, std::string_view const& filename) : base_error(msg, function, file, line), FileName(filename) { }
 	};
+	struct encoding_error : public base_error
+	{
+		size_t const Offset;
+
+		encoding_error(const std::string& function, const std::string& file, int line, size_t offset) : base_error("Invalid encoding at offset " + std::to_string(offset), function, file, line), Offset(offset) {}
+		encoding_error(const std::string& msg, const std::string& function, const std::string& file, int line, size_t offset) : base_error(msg, function, file, line), Offset(offset) { }
+	};
 	struct item_not_found_exception : public base_error
 	{
 		item_not_found_exception(const std::string& function, const std::string& file, int line) : base_error("Item not found.", function, file, line) { }
@@ -0,0 +1,578 @@
+#ifndef UTILITIES_FILE_ASYNC_HPP
+#define UTILITIES_FILE_ASYNC_HPP
+
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <system_error>
+#include <condition_variable>
+
+#include "file.hpp"
+#include "thread_pool.hpp"
+#include "exceptions.hpp"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(__linux__) && !defined(UTILITIES_FILE_ASYNC_NO_IO_URING) && __has_include(<linux/io_uring.h>)
+#define UTILITIES_FILE_ASYNC_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+namespace Utilities
+{
+	/*!
+	* @brief Outcome of one asynchronous file operation.
+	*/
+	struct file_io_result
+	{
+		std::string FileName;
+		std::string Content;		// whole file for reads, empty for writes
+		size_t Transferred = 0;
+		int Error = 0;				// errno, 0 on success
+
+		explicit operator bool() const { return Error == 0; }
+	};
+
+	/*!
+	* @brief Batched whole-file reads and writes.
+	* Requests are submitted through io_uring when the kernel allows it (5.6+, not blocked by seccomp),
+	* otherwise they are executed by a pool of pread/pwrite workers.
+	* Completion callbacks run on the engine's threads, also for requests that fail to open, and must not block.
+	* Files whose size stat() cannot tell (/proc, pipes, devices) are read sequentially until EOF.
+	*/
+	class async_file_engine
+	{
+	public:
+		using completion_type = std::function<void(file_io_result& result)>;
+	private:
+		enum class _op_kind { read, write };
+
+		struct _op
+		{
+			_op_kind Kind;
+			int Fd = -1;
+			size_t Size = 0;			// bytes to transfer, for sequential reads the current buffer size
+			bool Sequential = false;	// read at the file position until EOF, growing the buffer
+			bool Ready = false;			// nothing to transfer, only the completion is left
+			file_io_result Result;
+			completion_type Completion;
+		};
+
+		static std::exception_ptr _to_exception(file_io_result const& r)
+		{
+			if (r.Error == ENOENT)
+				return std::make_exception_ptr(construct_error_args_no_msg(Exceptions::file_not_found_error, r.FileName));
+			return std::make_exception_ptr(std::system_error{ r.Error, std::generic_category(), r.FileName });
+		}
+
+		static void _complete(std::unique_ptr<_op> op)
+		{
+#if !defined(_WIN32)
+			if (op->Fd >= 0)
+				::close(op->Fd);
+#endif
+			if (op->Result.Error == 0 && op->Kind == _op_kind::read)
+				op->Result.Content.resize(op->Result.Transferred);
+			if (op->Completion)
+				op->Completion(op->Result);
+		}
+
+		static constexpr size_t _sequentialChunk = 64 * 1024;
+
+		/*
+		* Opens the file and sizes the buffer. Sets `Ready` when there is nothing to transfer
+		* (open failure or empty write); the caller then only has to complete it.
+		*/
+		static void _prepare(_op& op)
+		{
+#if !defined(_WIN32)
+			auto& r = op.Result;
+			if (op.Kind == _op_kind::read)
+			{
+				op.Fd = ::open(r.FileName.c_str(), O_RDONLY | O_CLOEXEC);
+				struct stat st {};
+				if (op.Fd < 0 || ::fstat(op.Fd, &st) != 0)
+					r.Error = errno;
+				else
+				{
+					// procfs, sysfs and character devices report 0 or a meaningless size
+					op.Sequential = !S_ISREG(st.st_mode) || st.st_size == 0;
+					op.Size = op.Sequential ? _sequentialChunk : static_cast<size_t>(st.st_size);
+					r.Content.resize(op.Size);
+				}
+			}
+			else
+			{
+				op.Fd = ::open(r.FileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+				if (op.Fd < 0)
+					r.Error = errno;
+				op.Size = r.Content.size();
+			}
+			op.Ready = r.Error != 0 || op.Size == 0;
+#endif
+		}
+		// a sequential read that filled its buffer goes on with a bigger one
+		static bool _grow(_op& op)
+		{
+			if (!op.Sequential || op.Result.Transferred < op.Size)
+				return false;
+			op.Size *= 2;
+			op.Result.Content.resize(op.Size);
+			return true;
+		}
+
+		static void _transfer_blocking(std::unique_ptr<_op> op)
+		{
+			auto& r = op->Result;
+#if !defined(_WIN32)
+			while (r.Transferred < op->Size || _grow(*op))
+			{
+				auto n = op->Kind == _op_kind::write
+					? ::pwrite(op->Fd, r.Content.data() + r.Transferred, op->Size - r.Transferred, r.Transferred)
+					: op->Sequential
+					? ::read(op->Fd, r.Content.data() + r.Transferred, op->Size - r.Transferred)
+					: ::pread(op->Fd, r.Content.data() + r.Transferred, op->Size - r.Transferred, r.Transferred);
+				if (n < 0 && errno == EINTR)
+					continue;
+				if (n < 0)
+				{
+					r.Error = errno;
+					break;
+				}
+				if (n == 0)
+					break;
+				r.Transferred += static_cast<size_t>(n);
+			}
+#else
+			try
+			{
+				if (op->Kind == _op_kind::read)
+					r.Content = file_read_text(r.FileName);
+				else
+					file_write(r.FileName, r.Content.data(), r.Content.size());
+				r.Transferred = r.Content.size();
+			}
+			catch (Exceptions::file_not_found_error const&)
+			{
+				r.Error = ENOENT;
+			}
+			catch (std::exception const&)
+			{
+				r.Error = EIO;
+			}
+#endif
+			_complete(std::move(op));
+		}
+
+#ifdef UTILITIES_FILE_ASYNC_IO_URING
+		struct _ring
+		{
+			int Fd = -1;
+			unsigned Entries = 0;
+
+			void* SqPtr = nullptr; size_t SqSize = 0;
+			void* CqPtr = nullptr; size_t CqSize = 0;
+			io_uring_sqe* Sqes = nullptr; size_t SqesSize = 0;
+
+			unsigned* SqHead; unsigned* SqTail; unsigned* SqMask; unsigned* SqArray;
+			unsigned* CqHead; unsigned* CqTail; unsigned* CqMask; io_uring_cqe* Cqes;
+
+			bool open(unsigned entries)
+			{
+				io_uring_params p {};
+				Fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &p));
+				if (Fd < 0)
+					return false;
+				// IORING_OP_READ/WRITE arrived together with this feature bit (5.6)
+				if (!(p.features & IORING_FEAT_RW_CUR_POS))
+				{
+					close();
+					return false;
+				}
+				Entries = p.sq_entries;
+
+				SqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+				CqSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+				bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+				if (single)
+					SqSize = CqSize = std::max(SqSize, CqSize);
+
+				SqPtr = ::mmap(nullptr, SqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Fd, IORING_OFF_SQ_RING);
+				if (SqPtr == MAP_FAILED) { SqPtr = nullptr; close(); return false; }
+				if (single)
+					CqPtr = SqPtr;
+				else
+				{
+					CqPtr = ::mmap(nullptr, CqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Fd, IORING_OFF_CQ_RING);
+					if (CqPtr == MAP_FAILED) { CqPtr = nullptr; close(); return false; }
+				}
+				SqesSize = p.sq_entries * sizeof(io_uring_sqe);
+				void* sqes = ::mmap(nullptr, SqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Fd, IORING_OFF_SQES);
+				if (sqes == MAP_FAILED) { close(); return false; }
+				Sqes = static_cast<io_uring_sqe*>(sqes);
+
+				auto sq = static_cast<char*>(SqPtr);
+				SqHead = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+				SqTail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+				SqMask = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+				SqArray = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+				auto cq = static_cast<char*>(CqPtr);
+				CqHead = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+				CqTail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+				CqMask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+				Cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+				return true;
+			}
+			void close()
+			{
+				if (Sqes) ::munmap(Sqes, SqesSize);
+				if (CqPtr && CqPtr != SqPtr) ::munmap(CqPtr, CqSize);
+				if (SqPtr) ::munmap(SqPtr, SqSize);
+				if (Fd >= 0) ::close(Fd);
+				Sqes = nullptr; CqPtr = SqPtr = nullptr; Fd = -1;
+			}
+
+			// Caller serializes producers and keeps at most Entries operations in flight, so the SQ never fills up.
+			void push(uint8_t opcode, int fd, void* addr, unsigned len, uint64_t offset, void* userData)
+			{
+				unsigned tail = *SqTail;
+				unsigned index = tail & *SqMask;
+				io_uring_sqe& sqe = Sqes[index];
+				sqe = {};
+				sqe.opcode = opcode;
+				sqe.fd = fd;
+				sqe.addr = reinterpret_cast<uint64_t>(addr);
+				sqe.len = len;
+				sqe.off = offset;
+				sqe.user_data = reinterpret_cast<uint64_t>(userData);
+				SqArray[index] = index;
+				std::atomic_ref<unsigned>(*SqTail).store(tail + 1, std::memory_order_release);
+			}
+			// SQEs pushed but not yet consumed by the kernel
+			unsigned queued() const
+			{
+				return std::atomic_ref<unsigned>(*SqTail).load(std::memory_order_relaxed)
+					- std::atomic_ref<unsigned>(*SqHead).load(std::memory_order_acquire);
+			}
+			// Takes back the SQEs the kernel did not consume, returns their user data. Caller serializes producers.
+			std::vector<void*> unpush()
+			{
+				std::vector<void*> userData;
+				unsigned head = std::atomic_ref<unsigned>(*SqHead).load(std::memory_order_acquire);
+				unsigned tail = *SqTail;
+				for (unsigned i = head; i != tail; ++i)
+					userData.push_back(reinterpret_cast<void*>(Sqes[SqArray[i & *SqMask]].user_data));
+				std::atomic_ref<unsigned>(*SqTail).store(head, std::memory_order_release);
+				return userData;
+			}
+			int enter(unsigned submit, unsigned wait)
+			{
+				int r;
+				do r = static_cast<int>(::syscall(__NR_io_uring_enter, Fd, submit, wait, wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0));
+				while (r < 0 && errno == EINTR);
+				return r;
+			}
+		};
+
+		_ring _uring;
+		std::thread _reaper;
+		std::mutex _submitMutex;
+		std::condition_variable _idle;
+		std::deque<std::unique_ptr<_op>> _pending;
+		size_t _inflight = 0;
+		bool _stop = false;
+
+		void _push_sqe(_op* op)
+		{
+			if (op->Ready)
+			{
+				// routes the completion through the reaper, so it runs on the engine's thread
+				_uring.push(IORING_OP_NOP, -1, nullptr, 0, 0, op);
+				return;
+			}
+			auto& r = op->Result;
+			size_t left = op->Size - r.Transferred;
+			unsigned len = static_cast<unsigned>(std::min<size_t>(left, 1u << 30));
+			// -1: at the file position, which needs IORING_FEAT_RW_CUR_POS (checked in open())
+			uint64_t offset = op->Sequential ? static_cast<uint64_t>(-1) : r.Transferred;
+			_uring.push(
+				op->Kind == _op_kind::read ? IORING_OP_READ : IORING_OP_WRITE,
+				op->Fd, r.Content.data() + r.Transferred, len, offset, op);
+		}
+		/*
+		* _submitMutex must be held. Hands all queued SQEs to the kernel. When it is busy (EAGAIN, EBUSY) and has
+		* operations of ours in flight, the rest is left queued for the reaper to retry after the next completion.
+		* On any other error the unconsumed SQEs are taken back and their operations fail into `failed`.
+		*/
+		void _flush(std::vector<std::unique_ptr<_op>>& failed)
+		{
+			while (auto queued = _uring.queued())
+			{
+				int r = _uring.enter(queued, 0);
+				if (r > 0)
+					continue;
+				int error = r == 0 ? EAGAIN : errno;
+				if (error == EAGAIN || error == EBUSY)
+				{
+					if (_inflight > queued)
+						return;
+					std::this_thread::yield();
+					continue;
+				}
+				for (auto userData : _uring.unpush())
+				{
+					auto op = static_cast<_op*>(userData);
+					if (op == nullptr)
+						continue;
+					op->Result.Error = error;
+					--_inflight;
+					failed.emplace_back(op);
+				}
+				return;
+			}
+		}
+		// _submitMutex must be held. Moves pending ops into the ring up to its depth.
+		unsigned _fill_ring()
+		{
+			unsigned n = 0;
+			while (!_pending.empty() && _inflight < _uring.Entries)
+			{
+				_push_sqe(_pending.front().release());
+				_pending.pop_front();
+				++_inflight;
+				++n;
+			}
+			return n;
+		}
+		void _reap_loop()
+		{
+			std::vector<std::unique_ptr<_op>> done;
+			bool stop = false;
+			while (!stop)
+			{
+				_uring.enter(0, 1);
+
+				std::unique_lock lk { _submitMutex };
+				unsigned head = *_uring.CqHead;
+				unsigned tail = std::atomic_ref<unsigned>(*_uring.CqTail).load(std::memory_order_acquire);
+				for (; head != tail; ++head)
+				{
+					io_uring_cqe& cqe = _uring.Cqes[head & *_uring.CqMask];
+					auto op = reinterpret_cast<_op*>(cqe.user_data);
+					if (op == nullptr)
+						continue;		// the destructor's wake-up
+					auto& r = op->Result;
+					if (!op->Ready)
+					{
+						if (cqe.res < 0 && cqe.res != -EINTR && cqe.res != -EAGAIN)
+							r.Error = -cqe.res;
+						else if (cqe.res > 0)
+							r.Transferred += static_cast<size_t>(cqe.res);
+					}
+
+					// Short transfer or full sequential buffer: keep the slot and ask for the rest
+					if (!op->Ready && r.Error == 0 && cqe.res != 0 && (r.Transferred < op->Size || _grow(*op)))
+					{
+						_push_sqe(op);
+						continue;
+					}
+					--_inflight;
+					done.emplace_back(op);
+				}
+				std::atomic_ref<unsigned>(*_uring.CqHead).store(head, std::memory_order_release);
+				_fill_ring();
+				_flush(done);
+				bool idle = _inflight == 0 && _pending.empty();
+				stop = _stop && idle;
+				lk.unlock();
+
+				for (auto& op : done)
+					_complete(std::move(op));
+				done.clear();
+				if (idle)
+					_idle.notify_all();
+			}
+		}
+#endif
+
+		std::unique_ptr<Threading::ThreadPool> _pool;
+
+		void _submit(std::vector<std::unique_ptr<_op>> ops)
+		{
+#ifdef UTILITIES_FILE_ASYNC_IO_URING
+			if (!_pool)
+			{
+				// opening happens outside the lock
+				for (auto& op : ops)
+					_prepare(*op);
+				std::vector<std::unique_ptr<_op>> failed;
+				{
+					std::lock_guard lk { _submitMutex };
+					for (auto& op : ops)
+						_pending.push_back(std::move(op));
+					_fill_ring();
+					_flush(failed);
+				}
+				// the ring itself is broken, there is no engine thread that could run these
+				for (auto& op : failed)
+					_complete(std::move(op));
+				return;
+			}
+#endif
+			for (auto& op : ops)
+			{
+				_pool->post([p = op.release()]
+				{
+					std::unique_ptr<_op> op { p };
+					_prepare(*op);
+					if (op->Ready)
+						_complete(std::move(op));
+					else
+						_transfer_blocking(std::move(op));
+				});
+			}
+		}
+
+		static std::unique_ptr<_op> _make_op(_op_kind kind, std::string fileName, std::string content, completion_type completion)
+		{
+			auto op = std::make_unique<_op>();
+			op->Kind = kind;
+			op->Result.FileName = std::move(fileName);
+			op->Result.Content = std::move(content);
+			op->Completion = std::move(completion);
+			return op;
+		}
+	public:
+		/*!
+		* @param depth maximum number of operations in flight on the io_uring path.
+		* @param workers number of pread/pwrite workers on the fallback path.
+		*/
+		async_file_engine(unsigned depth = 256, size_t workers = std::thread::hardware_concurrency())
+		{
+#ifdef UTILITIES_FILE_ASYNC_IO_URING
+			if (_uring.open(depth))
+			{
+				_reaper = std::thread { &async_file_engine::_reap_loop, this };
+				return;
+			}
+#endif
+			_pool = std::make_unique<Threading::ThreadPool>(workers);
+		}
+		async_file_engine(const async_file_engine& rhs) = delete;
+		async_file_engine(async_file_engine&& rhs) = delete;
+		~async_file_engine()
+		{
+#ifdef UTILITIES_FILE_ASYNC_IO_URING
+			if (!_pool)
+			{
+				std::unique_lock lk { _submitMutex };
+				_idle.wait(lk, [&] { return _inflight == 0 && _pending.empty(); });
+				// wakes the reaper, which sees _stop once it has reaped
+				_stop = true;
+				_uring.push(IORING_OP_NOP, -1, nullptr, 0, 0, nullptr);
+				std::vector<std::unique_ptr<_op>> failed;
+				_flush(failed);
+				lk.unlock();
+				_reaper.join();
+				_uring.close();
+			}
+#endif
+		}
+
+		bool is_io_uring() const { return !_pool; }
+
+		void read(std::string fileName, completion_type completion)
+		{
+			std::vector<std::unique_ptr<_op>> ops;
+			ops.push_back(_make_op(_op_kind::read, std::move(fileName), {}, std::move(completion)));
+			_submit(std::move(ops));
+		}
+		void write(std::string fileName, std::string content, completion_type completion)
+		{
+			std::vector<std::unique_ptr<_op>> ops;
+			ops.push_back(_make_op(_op_kind::write, std::move(fileName), std::move(content), std::move(completion)));
+			_submit(std::move(ops));
+		}
+
+		std::future<std::string> read(std::string fileName)
+		{
+			auto promise = std::make_shared<std::promise<std::string>>();
+			auto future = promise->get_future();
+			read(std::move(fileName), [promise](file_io_result& r)
+			{
+				if (r)
+					promise->set_value(std::move(r.Content));
+				else
+					promise->set_exception(_to_exception(r));
+			});
+			return future;
+		}
+		std::future<size_t> write(std::string fileName, std::string content)
+		{
+			auto promise = std::make_shared<std::promise<size_t>>();
+			auto future = promise->get_future();
+			write(std::move(fileName), std::move(content), [promise](file_io_result& r)
+			{
+				if (r)
+					promise->set_value(r.Transferred);
+				else
+					promise->set_exception(_to_exception(r));
+			});
+			return future;
+		}
+
+		/*!
+		* @brief Submits all reads as one batch. Callback is invoked once per file.
+		*/
+		template<typename TContainer>
+		void read_all(TContainer const& fileNames, completion_type completion)
+		{
+			std::vector<std::unique_ptr<_op>> ops;
+			ops.reserve(fileNames.size());
+			for (auto const& fileName : fileNames)
+				ops.push_back(_make_op(_op_kind::read, fs::path(fileName).string(), {}, completion));
+			_submit(std::move(ops));
+		}
+		/*!
+		* @return futures in the same order as fileNames.
+		*/
+		template<typename TContainer>
+		std::vector<std::future<std::string>> read_all(TContainer const& fileNames)
+		{
+			std::vector<std::future<std::string>> futures;
+			std::vector<std::unique_ptr<_op>> ops;
+			futures.reserve(fileNames.size());
+			ops.reserve(fileNames.size());
+			for (auto const& fileName : fileNames)
+			{
+				auto promise = std::make_shared<std::promise<std::string>>();
+				futures.push_back(promise->get_future());
+				ops.push_back(_make_op(_op_kind::read, fs::path(fileName).string(), {}, [promise](file_io_result& r)
+				{
+					if (r)
+						promise->set_value(std::move(r.Content));
+					else
+						promise->set_exception(_to_exception(r));
+				}));
+			}
+			_submit(std::move(ops));
+			return futures;
+		}
+	};
+}
+
+#endif //UTILITIES_FILE_ASYNC_HPP
@@ -0,0 +1,229 @@
+#ifndef UTILITIES_FILE_CACHE_HPP
+#define UTILITIES_FILE_CACHE_HPP
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <system_error>
+
+#include "file.hpp"
+#include "exceptions.hpp"
+
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#endif
+
+namespace Utilities
+{
+	/*!
+	* @brief Thread-safe cache of file_read_text results.
+	* Entries are revalidated against (mtime, size, inode) at most once per interval and evicted in LRU order
+	* once the byte budget is exceeded. Returned buffers are immutable and stay valid after eviction.
+	*/
+	class file_cache
+	{
+	public:
+		using buffer_type = std::shared_ptr<const std::string>;
+		using clock_type = std::chrono::steady_clock;
+
+		struct statistics
+		{
+			uint64_t Hits = 0;
+			uint64_t Misses = 0;
+			uint64_t Revalidations = 0;		// stat() calls on cached entries
+			uint64_t Reloads = 0;			// entries found stale on revalidation
+			uint64_t Evictions = 0;
+			size_t Bytes = 0;
+			size_t Entries = 0;
+		};
+	private:
+		struct _stamp
+		{
+			int64_t MTime = 0;
+			uint64_t Size = 0;
+			uint64_t Inode = 0;
+
+			bool operator==(_stamp const& rhs) const = default;
+		};
+		struct _entry
+		{
+			buffer_type Buffer;
+			_stamp Stamp;
+			clock_type::time_point Checked;
+			std::list<std::string>::iterator Lru;
+		};
+
+		mutable std::mutex _mutex;
+		std::unordered_map<std::string, _entry> _entries;
+		std::list<std::string> _lru;		// front is most recently used
+		size_t _budget;
+		clock_type::duration _interval;
+		statistics _stats;
+
+		static _stamp _stat(std::string const& fileName)
+		{
+#if !defined(_WIN32)
+			struct stat st {};
+			if (::stat(fileName.c_str(), &st) != 0)
+				throw construct_error_args_no_msg(Exceptions::file_not_found_error, fileName);
+			return _stamp {
+				static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec,
+				static_cast<uint64_t>(st.st_size),
+				static_cast<uint64_t>(st.st_ino)
+			};
+#else
+			std::error_code ec;
+			auto mtime = fs::last_write_time(fileName, ec);
+			auto size = ec ? 0 : fs::file_size(fileName, ec);
+			if (ec)
+				throw construct_error_args_no_msg(Exceptions::file_not_found_error, fileName);
+			return _stamp { static_cast<int64_t>(mtime.time_since_epoch().count()), size, 0 };
+#endif
+		}
+
+		// _mutex must be held
+		void _erase(std::unordered_map<std::string, _entry>::iterator it)
+		{
+			_stats.Bytes -= it->second.Buffer->size();
+			_lru.erase(it->second.Lru);
+			_entries.erase(it);
+		}
+		void _shrink()
+		{
+			while (_stats.Bytes > _budget && !_lru.empty())
+			{
+				_erase(_entries.find(_lru.back()));
+				++_stats.Evictions;
+			}
+			_stats.Entries = _entries.size();
+		}
+	public:
+		file_cache(size_t byteBudget = 64 * 1024 * 1024, std::chrono::milliseconds revalidateInterval = std::chrono::seconds(1)) :
+			_budget(byteBudget), _interval(revalidateInterval)
+		{}
+		file_cache(const file_cache& rhs) = delete;
+
+		/*!
+		* @brief Process-wide instance with the default budget and interval.
+		*/
+		static file_cache& shared()
+		{
+			static file_cache instance;
+			return instance;
+		}
+
+		buffer_type read(std::string const& fileName)
+		{
+			auto now = clock_type::now();
+			std::optional<_stamp> cached;
+			{
+				std::lock_guard lk { _mutex };
+				auto it = _entries.find(fileName);
+				if (it != _entries.end())
+				{
+					auto& e = it->second;
+					_lru.splice(_lru.begin(), _lru, e.Lru);
+					if (now - e.Checked < _interval)
+					{
+						++_stats.Hits;
+						return e.Buffer;
+					}
+					cached = e.Stamp;
+				}
+			}
+
+			// stat and read without holding the lock
+			_stamp stamp;
+			buffer_type buffer;
+			try
+			{
+				stamp = _stat(fileName);
+				if (cached.has_value())
+				{
+					std::lock_guard lk { _mutex };
+					++_stats.Revalidations;
+					auto it = _entries.find(fileName);
+					if (stamp == *cached && it != _entries.end() && it->second.Stamp == stamp)
+					{
+						it->second.Checked = now;
+						++_stats.Hits;
+						return it->second.Buffer;
+					}
+					++_stats.Reloads;
+				}
+
+				buffer = std::make_shared<const std::string>(file_read_text(fileName));
+			}
+			catch (...)
+			{
+				// a deleted file must not stay cached, serving stale content and holding budget
+				invalidate(fileName);
+				throw;
+			}
+
+			std::lock_guard lk { _mutex };
+			++_stats.Misses;
+			auto it = _entries.find(fileName);
+			if (it != _entries.end())
+				_erase(it);
+			if (buffer->size() <= _budget)
+			{
+				_lru.push_front(fileName);
+				_entries.emplace(fileName, _entry { buffer, stamp, now, _lru.begin() });
+				_stats.Bytes += buffer->size();
+			}
+			_shrink();
+			return buffer;
+		}
+
+		void invalidate(std::string const& fileName)
+		{
+			std::lock_guard lk { _mutex };
+			auto it = _entries.find(fileName);
+			if (it != _entries.end())
+				_erase(it);
+			_stats.Entries = _entries.size();
+		}
+		void clear()
+		{
+			std::lock_guard lk { _mutex };
+			_entries.clear();
+			_lru.clear();
+			_stats.Bytes = 0;
+			_stats.Entries = 0;
+		}
+
+		void set_budget(size_t byteBudget)
+		{
+			std::lock_guard lk { _mutex };
+			_budget = byteBudget;
+			_shrink();
+		}
+		void set_revalidate_interval(std::chrono::milliseconds interval)
+		{
+			std::lock_guard lk { _mutex };
+			_interval = interval;
+		}
+
+		statistics stats() const
+		{
+			std::lock_guard lk { _mutex };
+			return _stats;
+		}
+	};
+
+	/*!
+	* @brief file_read_text through the shared file_cache.
+	*/
+	inline file_cache::buffer_type file_read_text_cached(std::string const& fileName)
+	{
+		return file_cache::shared().read(fileName);
+	}
+}
+
+#endif //UTILITIES_FILE_CACHE_HPP
@@ -0,0 +1,299 @@
+#ifndef UTILITIES_FILE_COPY_HPP
+#define UTILITIES_FILE_COPY_HPP
+
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstdint>
+#include <optional>
+#include <algorithm>
+#include <functional>
+#include <system_error>
+
+#include "file.hpp"
+#include "crc32.hpp"
+#include "exceptions.hpp"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+#if defined(__linux__)
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+#endif
+
+namespace Utilities
+{
+	enum class file_copy_method { reflink, copy_file_range, sendfile, buffered, rename };
+
+	struct file_copy_options
+	{
+		bool Reflink = true;				// share extents when the filesystem supports it
+		bool Verify = false;				// compare CRC32 of source and destination after copying
+		size_t ChunkSize = 8 * 1024 * 1024;	// bytes per syscall, also the progress granularity
+		std::function<void(uint64_t copied, uint64_t total)> Progress;
+	};
+
+	struct file_copy_result
+	{
+		uint64_t Bytes = 0;
+		file_copy_method Method = file_copy_method::buffered;	// the last method used
+		std::optional<unsigned int> Crc;						// set when Verify was requested
+	};
+
+#if !defined(_WIN32)
+	namespace _file_copy
+	{
+		struct descriptor
+		{
+			int Fd = -1;
+			descriptor(int fd) : Fd(fd) {}
+			descriptor(const descriptor& rhs) = delete;
+			~descriptor() { if (Fd >= 0) ::close(Fd); }
+			operator int() const { return Fd; }
+		};
+
+		[[noreturn]] inline void raise(std::string const& fileName)
+		{
+			if (errno == ENOENT)
+				throw construct_error_args_no_msg(Exceptions::file_not_found_error, fileName);
+			throw std::system_error{ errno, std::generic_category(), fileName };
+		}
+
+		inline unsigned int crc(int fd, uint64_t offset, uint64_t length, std::string const& fileName)
+		{
+			CRC32 crc;
+			std::vector<char> buffer(std::min<uint64_t>(length, 1 << 20));
+			while (length > 0)
+			{
+				auto n = ::pread(fd, buffer.data(), std::min<uint64_t>(length, buffer.size()), offset);
+				if (n < 0 && errno == EINTR)
+					continue;
+				if (n < 0)
+					raise(fileName);
+				if (n == 0)
+					throw construct_error(Exceptions::base_error, "unexpected end of file while verifying " + fileName);
+				crc.compute(buffer.data(), n);
+				offset += n;
+				length -= n;
+			}
+			return crc.value();
+		}
+
+		// errors after which the next, more general method is tried
+		inline bool unsupported(int error)
+		{
+			return error == EXDEV || error == ENOSYS || error == EINVAL || error == EOPNOTSUPP
+				|| error == ENOTTY || error == EBADF || error == EPERM;
+		}
+
+		inline file_copy_result copy(
+			std::string const& from, uint64_t fromOffset,
+			std::string const& to, uint64_t toOffset,
+			std::optional<uint64_t> length, bool truncate,
+			file_copy_options const& options
+		) {
+			descriptor src = ::open(from.c_str(), O_RDONLY | O_CLOEXEC);
+			struct stat st {};
+			if (src < 0 || ::fstat(src, &st) != 0)
+				raise(from);
+			uint64_t size = static_cast<uint64_t>(st.st_size);
+			uint64_t total = fromOffset >= size ? 0 : std::min(length.value_or(size), size - fromOffset);
+
+			// opening `to` with O_TRUNC would empty the source; a range within one file is fine if it does not overlap
+			struct stat existing {};
+			if (::stat(to.c_str(), &existing) == 0 && existing.st_dev == st.st_dev && existing.st_ino == st.st_ino
+				&& (truncate || (fromOffset < toOffset + total && toOffset < fromOffset + total)))
+				throw construct_error(Exceptions::base_error, "cannot copy " + from + " onto itself (" + to + ")");
+
+			descriptor dst = ::open(to.c_str(), (options.Verify ? O_RDWR : O_WRONLY) | O_CREAT | O_CLOEXEC | (truncate ? O_TRUNC : 0), st.st_mode & 0777);
+			if (dst < 0)
+				raise(to);
+
+			file_copy_result result;
+			auto chunk = std::max<size_t>(options.ChunkSize, 4096);
+			auto progress = [&] { if (options.Progress) options.Progress(result.Bytes, total); };
+			bool done = total == 0;
+
+#if defined(__linux__)
+			if (!done && options.Reflink)
+			{
+				int r;
+				if (truncate && fromOffset == 0 && total == size)
+					r = ::ioctl(dst, FICLONE, src.Fd);
+				else
+				{
+					file_clone_range range { src.Fd, fromOffset, total, toOffset };
+					r = ::ioctl(dst, FICLONERANGE, &range);
+				}
+				if (r == 0)
+				{
+					result.Bytes = total;
+					result.Method = file_copy_method::reflink;
+					done = true;
+				}
+			}
+
+			if (!done)
+			{
+				result.Method = file_copy_method::copy_file_range;
+				loff_t in = fromOffset + result.Bytes, out = toOffset + result.Bytes;
+				while (result.Bytes < total)
+				{
+					auto n = ::copy_file_range(src, &in, dst, &out, std::min<uint64_t>(total - result.Bytes, chunk), 0);
+					if (n < 0 && errno == EINTR)
+						continue;
+					if (n < 0 && unsupported(errno))
+						break;
+					if (n < 0)
+						raise(to);
+					if (n == 0)
+						break;
+					result.Bytes += n;
+					progress();
+				}
+				done = result.Bytes == total;
+			}
+
+			if (!done && ::lseek(dst, toOffset + result.Bytes, SEEK_SET) >= 0)
+			{
+				result.Method = file_copy_method::sendfile;
+				off_t in = fromOffset + result.Bytes;
+				while (result.Bytes < total)
+				{
+					auto n = ::sendfile(dst, src, &in, std::min<uint64_t>(total - result.Bytes, chunk));
+					if (n < 0 && errno == EINTR)
+						continue;
+					if (n < 0 && unsupported(errno))
+						break;
+					if (n < 0)
+						raise(to);
+					if (n == 0)
+						break;
+					result.Bytes += n;
+					progress();
+				}
+				done = result.Bytes == total;
+			}
+#endif
+
+			if (!done)
+			{
+				result.Method = file_copy_method::buffered;
+				std::vector<char> buffer(std::min<uint64_t>(total - result.Bytes, chunk));
+				while (result.Bytes < total)
+				{
+					auto n = ::pread(src, buffer.data(), std::min<uint64_t>(total - result.Bytes, buffer.size()), fromOffset + result.Bytes);
+					if (n < 0 && errno == EINTR)
+						continue;
+					if (n < 0)
+						raise(from);
+					if (n == 0)
+						break;
+					for (ssize_t written = 0; written < n; )
+					{
+						auto w = ::pwrite(dst, buffer.data() + written, n - written, toOffset + result.Bytes + written);
+						if (w < 0 && errno == EINTR)
+							continue;
+						if (w < 0)
+							raise(to);
+						written += w;
+					}
+					result.Bytes += n;
+					progress();
+				}
+			}
+
+			if (options.Verify)
+			{
+				auto expected = crc(src, fromOffset, result.Bytes, from);
+				auto actual = crc(dst.Fd, toOffset, result.Bytes, to);
+				if (expected != actual)
+					throw construct_error(Exceptions::base_error, "CRC32 mismatch after copying " + from + " to " + to);
+				result.Crc = actual;
+			}
+			if (result.Method == file_copy_method::reflink)
+				progress();
+			return result;
+		}
+	}
+#endif
+
+	/*!
+	* @brief Copies a whole file, keeping the data inside the kernel where possible:
+	* FICLONE reflink, then copy_file_range, then sendfile, then a pread/pwrite loop.
+	*/
+	inline file_copy_result file_copy(std::string const& from, std::string const& to, file_copy_options const& options = {})
+	{
+#if !defined(_WIN32)
+		return _file_copy::copy(from, 0, to, 0, {}, true, options);
+#else
+		std::error_code ec;
+		if (fs::equivalent(from, to, ec))
+			throw construct_error(Exceptions::base_error, "cannot copy " + from + " onto itself (" + to + ")");
+		if (!fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec))
+		{
+			if (!fs::exists(from))
+				throw construct_error_args_no_msg(Exceptions::file_not_found_error, from);
+			throw std::system_error{ ec, to };
+		}
+		file_copy_result result;
+		result.Bytes = fs::file_size(to);
+		if (options.Progress)
+			options.Progress(result.Bytes, result.Bytes);
+		if (options.Verify)
+		{
+			auto src = file_open_binary(from);
+			auto dst = file_open_binary(to);
+			auto expected = CRC32::compute_stream(src);
+			result.Crc = CRC32::compute_stream(dst);
+			if (expected != result.Crc)
+				throw construct_error(Exceptions::base_error, "CRC32 mismatch after copying " + from + " to " + to);
+		}
+		return result;
+#endif
+	}
+
+#if !defined(_WIN32)
+	/*!
+	* @brief Copies `length` bytes (or up to the end of the source) between offsets, the destination is not truncated.
+	*/
+	inline file_copy_result file_copy_range(
+		std::string const& from, uint64_t fromOffset,
+		std::string const& to, uint64_t toOffset,
+		std::optional<uint64_t> length = {},
+		file_copy_options const& options = {}
+	) {
+		return _file_copy::copy(from, fromOffset, to, toOffset, length, false, options);
+	}
+#endif
+
+	/*!
+	* @brief Renames the file, or copies and removes it when the destination is on another filesystem.
+	*/
+	inline file_copy_result file_move(std::string const& from, std::string const& to, file_copy_options const& options = {})
+	{
+		std::error_code ec;
+		fs::rename(from, to, ec);
+		if (!ec)
+		{
+			file_copy_result result;
+			result.Method = file_copy_method::rename;
+			result.Bytes = fs::file_size(to, ec);
+			return result;
+		}
+		if (ec == std::errc::no_such_file_or_directory && !fs::exists(from))
+			throw construct_error_args_no_msg(Exceptions::file_not_found_error, from);
+		if (ec != std::errc::cross_device_link)
+			throw std::system_error{ ec, from };
+
+		auto result = file_copy(from, to, options);
+		fs::remove(from);
+		return result;
+	}
+}
+
+#endif //UTILITIES_FILE_COPY_HPP
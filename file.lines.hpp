@@ -0,0 +1,232 @@
+#ifndef UTILITIES_FILE_LINES_HPP
+#define UTILITIES_FILE_LINES_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <future>
+#include <utility>
+#include <cstring>
+#include <algorithm>
+#include <system_error>
+#include <type_traits>
+
+#include "file.hpp"
+#include "thread_pool.hpp"
+#include "exceptions.hpp"
+
+#if defined(_WIN32)
+// min/max macros would break std::min/std::max in everything included after this header
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace Utilities
+{
+	/*!
+	* @brief Read-only memory mapping of a whole file.
+	*/
+	class mapped_file
+	{
+	private:
+		const char* _data = nullptr;
+		size_t _size = 0;
+#if defined(_WIN32)
+		HANDLE _file = INVALID_HANDLE_VALUE;
+		HANDLE _mapping = nullptr;
+#endif
+		void _release()
+		{
+#if defined(_WIN32)
+			if (_data) UnmapViewOfFile(_data);
+			if (_mapping) CloseHandle(_mapping);
+			if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+			_mapping = nullptr;
+			_file = INVALID_HANDLE_VALUE;
+#else
+			if (_data) ::munmap(const_cast<char*>(_data), _size);
+#endif
+			_data = nullptr;
+			_size = 0;
+		}
+	public:
+		mapped_file(std::string const& fileName)
+		{
+#if defined(_WIN32)
+			_file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (_file == INVALID_HANDLE_VALUE)
+				throw construct_error_args_no_msg(Exceptions::file_not_found_error, fileName);
+			LARGE_INTEGER size {};
+			GetFileSizeEx(_file, &size);
+			_size = static_cast<size_t>(size.QuadPart);
+			if (_size == 0)
+				return;
+			_mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			_data = _mapping ? static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+			if (!_data)
+			{
+				_release();
+				throw std::system_error{ static_cast<int>(GetLastError()), std::system_category(), fileName };
+			}
+#else
+			int fd = ::open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+			struct stat st {};
+			if (fd < 0 || ::fstat(fd, &st) != 0)
+			{
+				int error = errno;
+				if (fd >= 0) ::close(fd);
+				if (error == ENOENT)
+					throw construct_error_args_no_msg(Exceptions::file_not_found_error, fileName);
+				throw std::system_error{ error, std::generic_category(), fileName };
+			}
+			_size = static_cast<size_t>(st.st_size);
+			if (_size > 0)
+			{
+				void* p = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+				int error = errno;
+				::close(fd);
+				if (p == MAP_FAILED)
+				{
+					_size = 0;
+					throw std::system_error{ error, std::generic_category(), fileName };
+				}
+				_data = static_cast<const char*>(p);
+				::madvise(p, _size, MADV_SEQUENTIAL);
+			}
+			else ::close(fd);
+#endif
+		}
+		mapped_file(const mapped_file& rhs) = delete;
+		mapped_file& operator=(const mapped_file& rhs) = delete;
+		~mapped_file() { _release(); }
+
+		size_t size() const { return _size; }
+		const char* data() const { return _data; }
+		std::string_view view() const { return { _data, _size }; }
+	};
+
+	/*!
+	* @brief Splits data into about `chunks` pieces, each ending right after a '\n' (except possibly the last one).
+	*/
+	inline std::vector<std::string_view> text_split_chunks(std::string_view data, size_t chunks)
+	{
+		std::vector<std::string_view> out;
+		if (data.empty())
+			return out;
+		if (chunks == 0)
+			chunks = 1;
+		size_t target = std::max<size_t>(data.size() / chunks, 1);
+		out.reserve(chunks + 1);
+		size_t begin = 0;
+		while (begin < data.size())
+		{
+			size_t end = begin + target;
+			if (end >= data.size())
+				end = data.size();
+			else
+			{
+				auto nl = static_cast<const char*>(std::memchr(data.data() + end - 1, '\n', data.size() - end + 1));
+				end = nl ? static_cast<size_t>(nl - data.data()) + 1 : data.size();
+			}
+			out.push_back(data.substr(begin, end - begin));
+			begin = end;
+		}
+		return out;
+	}
+
+	/*!
+	* @brief Invokes callable(line) for every line in text, without the trailing "\n" or "\r\n".
+	*/
+	template<typename TCallable>
+	inline void text_for_each_line(std::string_view text, TCallable&& callable)
+	{
+		while (!text.empty())
+		{
+			auto nl = static_cast<const char*>(std::memchr(text.data(), '\n', text.size()));
+			size_t length = nl ? static_cast<size_t>(nl - text.data()) : text.size();
+			auto line = text.substr(0, length);
+			if (!line.empty() && line.back() == '\r')
+				line.remove_suffix(1);
+			callable(line);
+			text.remove_prefix(nl ? length + 1 : length);
+		}
+	}
+
+	/*!
+	* @brief Maps the file and runs callable(chunk) for newline-aligned chunks on the pool.
+	* The calling thread must not be one of the pool's threads.
+	* @return results in file order.
+	*/
+	template<typename TCallable>
+	auto file_map_chunks(std::string const& fileName, TCallable callable, Threading::ThreadPool& pool, size_t chunkSize = 4 * 1024 * 1024)
+		-> std::vector<std::invoke_result_t<TCallable&, std::string_view>>
+	{
+		using result_type = std::invoke_result_t<TCallable&, std::string_view>;
+
+		mapped_file file { fileName };
+		size_t chunks = std::max<size_t>(1, file.size() / std::max<size_t>(chunkSize, 1));
+		auto views = text_split_chunks(file.view(), chunks);
+
+		std::vector<std::future<result_type>> futures;
+		futures.reserve(views.size());
+		for (auto view : views)
+			futures.push_back(pool.submit([view, &callable] { return callable(view); }));
+
+		std::vector<result_type> results;
+		results.reserve(futures.size());
+		// wait for everything before rethrowing, the mapping must outlive the tasks
+		for (auto& f : futures)
+			f.wait();
+		for (auto& f : futures)
+			results.push_back(f.get());
+		return results;
+	}
+
+	/*!
+	* @brief Folds every line of the file into per-chunk accumulators in parallel, then reduces them in file order.
+	* Each chunk starts from a value-initialised TResult, `init` is folded in exactly once, as the first accumulator.
+	* @param fold void(TResult& acc, std::string_view line)
+	* @param reduce void(TResult& acc, TResult&& chunk)
+	*/
+	template<typename TResult, typename TFold, typename TReduce>
+	TResult file_reduce_lines(
+		std::string const& fileName, TResult init, TFold fold, TReduce reduce,
+		Threading::ThreadPool& pool, size_t chunkSize = 4 * 1024 * 1024
+	) {
+		auto partials = file_map_chunks(fileName, [&fold](std::string_view chunk)
+		{
+			TResult acc {};
+			text_for_each_line(chunk, [&acc, &fold](std::string_view line) { fold(acc, line); });
+			return acc;
+		}, pool, chunkSize);
+
+		for (auto& partial : partials)
+			reduce(init, std::move(partial));
+		return init;
+	}
+
+	/*!
+	* @brief Runs callable(line) for every line of the file in parallel; lines of one chunk are visited in order.
+	*/
+	template<typename TCallable>
+	void file_for_each_line(std::string const& fileName, TCallable callable, Threading::ThreadPool& pool, size_t chunkSize = 4 * 1024 * 1024)
+	{
+		file_map_chunks(fileName, [&callable](std::string_view chunk)
+		{
+			text_for_each_line(chunk, callable);
+			return true;
+		}, pool, chunkSize);
+	}
+}
+
+#endif //UTILITIES_FILE_LINES_HPP
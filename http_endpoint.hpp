@@ -10,6 +10,9 @@
 #include "logging.hpp"
 #include "exceptions.hpp"
 #include "exceptions.rest.hpp"
+#include "string.utf8.hpp"
+#include "string.ascii.hpp"
+#include "delegate.hpp"
 
 #include <date/date.h>
 #include <libpq-fe.h>
@@ -61,12 +64,12 @@ namespace HTTP
 		* @author multfinite@gmail.com (multfinite)
 		* @brief Handler function type for endpoint which not require request content.
 		*/
-		using EndpointHandler				= std::function<void(const HttpSession session, TService& service, HttpResponse& response, bool& autosend, TData& data)>;
+		using EndpointHandler				= Delegate<void(const HttpSession session, TService& service, HttpResponse& response, bool& autosend, TData& data)>;
 		/*!
 		* @author multfinite@gmail.com (multfinite)
 		* @brief Handler function type for endpoint which require request content (with fetching).
 		*/
-		using FetchedEndpointHandler		= std::function<void(const HttpSession session, string content, TService& service, HttpResponse& response, bool& autosend, TData& data)>;
+		using FetchedEndpointHandler		= Delegate<void(const HttpSession session, string content, TService& service, HttpResponse& response, bool& autosend, TData& data)>;
 		/*!
 		* @author multfinite@gmail.com (multfinite)
 		* @brief creates content for error response
@@ -92,6 +95,24 @@ namespace HTTP
 			headers.insert({ "Content-Length", std::to_string(content.size()) });
 			headers.insert({ "Content-Type", "application/json" });
 		}
+		/*!
+		* @brief true for media types whose body is text (text/*, JSON, XML, form data), which must be valid UTF-8
+		*/
+		static bool is_textual_content_type(string contentType)
+		{
+			contentType = contentType.substr(0, contentType.find(';'));
+			ascii_tolower_inplace(contentType);
+			auto endsWith = [&contentType](std::string_view suffix)
+			{
+				return contentType.size() >= suffix.size() && contentType.compare(contentType.size() - suffix.size(), suffix.size(), suffix) == 0;
+			};
+			return contentType.starts_with("text/")
+				|| contentType.starts_with("application/json")
+				|| contentType == "application/xml"
+				|| contentType == "application/javascript"
+				|| contentType == "application/x-www-form-urlencoded"
+				|| endsWith("+json") || endsWith("+xml");
+		}
 	private:
 		shared_ptr<TServiceConstructor>	_ctorObj;
 		shared_ptr<restbed::Resource>		_resource;
@@ -241,6 +262,12 @@ namespace HTTP
 					};
 
 					string content = restbed::String::to_string(raw);
+					// textual bodies must be UTF-8 and are rejected before the handler runs, binary uploads reach it
+					// untouched; only the logged copy is sanitized, so the json log message stays dumpable
+					bool const validContent = utf8_validate(content);
+					bool const rejectContent = !validContent && is_textual_content_type(session->get_request()->get_header("Content-Type", string{}));
+					string const sanitizedContent = validContent ? string{} : utf8_sanitize(content);
+					string const& loggedContent = validContent ? content : sanitizedContent;
 					TService service = _ctorObj->construct();
 					TData data{};
 					HttpResponse response{};
@@ -248,6 +275,8 @@ namespace HTTP
 
 					try
 					{
+						if (rejectContent)
+							throw construct_error_args(Exceptions::REST::invalid_argument_error, "Request content is not valid UTF-8", "content");
 						handler(session, content, service, response, autosend, data);
 						auto handledTime = std::chrono::system_clock::now();
 						if (autosend)
@@ -257,7 +286,7 @@ namespace HTTP
 						}
 						
 						auto msg	= create_message(
-							"Success", content, response,
+							"Success", loggedContent, response,
 							receivedTime, handledTime,
 							session, service, {}
 						);						
@@ -274,7 +303,7 @@ namespace HTTP
 
 						auto exception	= ex.format_block();
 						auto msg			= create_message(
-							(string) ex.what(), content, response,
+							(string) ex.what(), loggedContent, response,
 							receivedTime, handledTime,
 							session, service, exception
 						);						
@@ -294,7 +323,7 @@ namespace HTTP
 
 						auto exception	= format_exception_block(ex);
 						auto msg			= create_message(
-							(string)ex.what(), content, response,
+							(string)ex.what(), loggedContent, response,
 							receivedTime, handledTime,
 							session, service, exception
 						);
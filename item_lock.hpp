@@ -1,8 +1,19 @@
 #ifndef UTILITIES_ITEM_LOCK_HPP
 #define UTILITIES_ITEM_LOCK_HPP
 
+#include <list>
 #include <mutex>
+#include <tuple>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <optional>
 #include <functional>
+#include <shared_mutex>
+#include <system_error>
+
+#include "lock_profiler.hpp"
 
 namespace Utilities
 {
@@ -12,66 +23,155 @@ namespace Utilities
 	using std::reference_wrapper;
 
 	struct __try_lock {};
-	template<typename T>
+
+	/*!
+	* @brief Exclusive access to an item while holding one or more mutexes, acquired deadlock-free with std::lock.
+	* The mutexes are kept in a tuple of pointers, so locking never allocates. try_obtain() and try_obtain_for()
+	* report failure with an empty optional instead of throwing.
+	* The default mutex follows UTILITIES_LOCK_PROFILING like obtainable_item's, so item_lock<T> names what obtain() returns.
+	*/
+	template<typename T, typename TMutex = instrumented_mutex<std::mutex>, typename ...TMutexes>
 	struct item_lock 
 	{
 	public:
-		
+		using mutex_type = TMutex;
+		static constexpr size_t mutex_count = 1 + sizeof...(TMutexes);
 	private:
-		T& _item;
-		list<reference_wrapper<std::mutex>> _mutexes;
+		T* _item;
+		std::tuple<TMutex*, TMutexes*...> _mutexes {};	// all null while nothing is held
+
+		static bool _try_lock_all(TMutex& mutex, TMutexes&... mutexes)
+		{
+			if constexpr (sizeof...(TMutexes) == 0)
+				return mutex.try_lock();
+			else
+				return std::try_lock(mutex, mutexes...) == -1;
+		}
 	public:
-		T& item() { return _item; }
-		item_lock(T& item) : _item(item) {}
+		T& item() { return *_item; }
+		item_lock(T& item) : _item(&item) {}
+		// takes over mutexes the caller has already locked
+		item_lock(std::adopt_lock_t, T& item, TMutex& mutex, TMutexes&... mutexes) : _item(&item), _mutexes(&mutex, &mutexes...) {}
 
-		template<typename ...TMutexes>
-		item_lock(T& item, TMutexes&... mutexes) :  _item(item) 
+		item_lock(T& item, TMutex& mutex, TMutexes&... mutexes) : _item(&item)
 		{
-			lock(mutexes...);
+			lock(mutex, mutexes...);
 		}
-		template<typename ...TMutexes>
-		item_lock(T& item, __try_lock ty, TMutexes&... mutexes) : _item(item)
+		/*!
+		* @brief Throwing try-lock kept for existing callers, prefer try_obtain().
+		* @throws std::system_error (resource_unavailable_try_again) when any mutex is busy.
+		*/
+		item_lock(T& item, __try_lock, TMutex& mutex, TMutexes&... mutexes) : _item(&item)
 		{
-			auto index = try_lock(mutexes...);
-			if (index != -1)
-				throw std::runtime_error{ std::to_string(index) };
+			if (!_try_lock_all(mutex, mutexes...))
+				throw std::system_error(std::make_error_code(std::errc::resource_unavailable_try_again));
+			_mutexes = { &mutex, &mutexes... };
+		}
+		item_lock(const item_lock& rhs) = delete;
+		item_lock(item_lock&& rhs) noexcept : _item(rhs._item), _mutexes(std::exchange(rhs._mutexes, {})) {}
+		item_lock& operator=(const item_lock& rhs) = delete;
+		item_lock& operator=(item_lock&& rhs) noexcept
+		{
+			if (this != &rhs)
+			{
+				unlock();
+				_item = rhs._item;
+				_mutexes = std::exchange(rhs._mutexes, {});
+			}
+			return *this;
 		}
 		~item_lock() 
 		{
 			unlock();
 		}
 
-		template<typename ...TMutexes>
-		void lock(TMutexes&... mutexes)
+		static std::optional<item_lock> try_obtain(T& item, TMutex& mutex, TMutexes&... mutexes)
 		{
-			std::lock(mutexes);
-			_mutexes = { mutexes };
+			if (!_try_lock_all(mutex, mutexes...))
+				return std::nullopt;
+			return std::optional<item_lock> { std::in_place, std::adopt_lock, item, mutex, mutexes... };
 		}
-		template<>
-		void lock<std::mutex>(std::mutex& mutex)
+		/*!
+		* @brief Gives up after `timeout`. A single timed mutex waits with try_lock_for, several are retried
+		* all-or-nothing with std::try_lock.
+		*/
+		template<typename TRep, typename TPeriod>
+		static std::optional<item_lock> try_obtain_for(T& item, std::chrono::duration<TRep, TPeriod> const& timeout, TMutex& mutex, TMutexes&... mutexes)
 		{
-			mutex.lock();
-			_mutexes = { mutex };
+			auto deadline = std::chrono::steady_clock::now() + timeout;
+			if constexpr (sizeof...(TMutexes) == 0 && requires { mutex.try_lock_until(deadline); })
+			{
+				if (!mutex.try_lock_until(deadline))
+					return std::nullopt;
+			}
+			else
+			{
+				while (!_try_lock_all(mutex, mutexes...))
+				{
+					if (std::chrono::steady_clock::now() >= deadline)
+						return std::nullopt;
+					std::this_thread::yield();
+				}
+			}
+			return std::optional<item_lock> { std::in_place, std::adopt_lock, item, mutex, mutexes... };
 		}
-		template<typename ...TMutexes>
-		auto try_lock(TMutexes&... mutexes)
+
+		void lock(TMutex& mutex, TMutexes&... mutexes)
 		{
-			auto r = std::try_lock(mutexes);
-			_mutexes = { mutexes };
-			return r;
+			unlock();
+			if constexpr (sizeof...(TMutexes) == 0)
+				mutex.lock();
+			else
+				std::lock(mutex, mutexes...);
+			_mutexes = { &mutex, &mutexes... };
 		}
-		template<>
-		auto try_lock<std::mutex>(std::mutex& mutex)
+		bool try_lock(TMutex& mutex, TMutexes&... mutexes)
 		{
-			int r = mutex.try_lock() ? -1 : 0;
-			_mutexes = { mutex };
-			return r;
+			unlock();
+			if (!_try_lock_all(mutex, mutexes...))
+				return false;
+			_mutexes = { &mutex, &mutexes... };
+			return true;
 		}
 		void unlock()
 		{
-			for (auto& m : _mutexes)
-				m.get().unlock();
+			if (!std::get<0>(_mutexes))
+				return;
+			std::apply([](auto*... m) { (m->unlock(), ...); }, _mutexes);
+			_mutexes = {};
 		}
+		bool owns_lock() const { return std::get<0>(_mutexes) != nullptr; }
+		explicit operator bool() const { return owns_lock(); }
+	};
+
+	template<typename T, typename TMutex, typename ...TMutexes>
+	item_lock(T&, TMutex&, TMutexes&...) -> item_lock<T, TMutex, TMutexes...>;
+
+	/*!
+	* @brief Read access to an item under a shared (reader) lock.
+	*/
+	template<typename T, typename TMutex = instrumented_mutex<std::shared_mutex>>
+	struct shared_item_lock
+	{
+	public:
+		using mutex_type = TMutex;
+	private:
+		const T& _item;
+		std::shared_lock<mutex_type> _lock;
+	public:
+		shared_item_lock(const T& item, mutex_type& mutex) : _item(item), _lock(mutex) {}
+		shared_item_lock(const T& item, std::shared_lock<mutex_type>&& lock) : _item(item), _lock(std::move(lock)) {}
+
+		static std::optional<shared_item_lock> try_obtain(const T& item, mutex_type& mutex)
+		{
+			std::shared_lock<mutex_type> lock { mutex, std::try_to_lock };
+			if (!lock.owns_lock())
+				return std::nullopt;
+			return std::optional<shared_item_lock> { std::in_place, item, std::move(lock) };
+		}
+
+		const T& item() const { return _item; }
+		void unlock() { if (_lock.owns_lock()) _lock.unlock(); }
 	};
 }
 
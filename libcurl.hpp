@@ -141,9 +141,10 @@ namespace Utilities
 			string headerBuffer, contentBuffer;
 	
 			struct curl_slist* curlHeaders = nullptr;
+			string headerLine;
 			for (auto& header : headers)
 			{
-				string headerLine	= string_format("%s: %s", header.first.c_str(), header.second.c_str());
+				headerLine.assign(header.first).append(": ").append(header.second);
 				curlHeaders			= curl_slist_append(curlHeaders, headerLine.c_str());
 			}
 	
@@ -0,0 +1,302 @@
+#ifndef UTILITIES_LOCK_PROFILER_HPP
+#define UTILITIES_LOCK_PROFILER_HPP
+
+#include <map>
+#include <mutex>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <string_view>
+
+/*
+* Lock contention profiling. Define UTILITIES_LOCK_PROFILING to make instrumented_mutex<T> a profiled_mutex<T>;
+* otherwise it is T itself and name_lock() does nothing, so builds without the macro pay nothing.
+*/
+
+namespace Utilities
+{
+	/*!
+	* @brief Log2 histogram of durations in nanoseconds: bucket i counts durations in [2^(i-1), 2^i).
+	*/
+	struct lock_histogram
+	{
+		static constexpr size_t buckets = 48;
+
+		std::array<std::atomic<uint64_t>, buckets> Buckets {};
+		std::atomic<uint64_t> Count = 0;
+		std::atomic<uint64_t> TotalNs = 0;
+		std::atomic<uint64_t> MaxNs = 0;
+
+		void record(uint64_t ns)
+		{
+			Buckets[std::min<size_t>(std::bit_width(ns), buckets - 1)].fetch_add(1, std::memory_order_relaxed);
+			Count.fetch_add(1, std::memory_order_relaxed);
+			TotalNs.fetch_add(ns, std::memory_order_relaxed);
+			auto max = MaxNs.load(std::memory_order_relaxed);
+			while (ns > max && !MaxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed));
+		}
+	};
+
+	struct lock_waiter
+	{
+		uint64_t WaitNs;
+		std::thread::id Thread;
+		std::chrono::system_clock::time_point Time;
+	};
+
+	struct lock_histogram_report
+	{
+		uint64_t Count = 0;
+		uint64_t TotalNs = 0;
+		uint64_t MaxNs = 0;
+		std::vector<uint64_t> Buckets;
+
+		/*!
+		* @brief Upper bound of the bucket holding the q-quantile, 0 when empty.
+		*/
+		uint64_t quantile(double q) const
+		{
+			if (Count == 0)
+				return 0;
+			auto rank = static_cast<uint64_t>(q * static_cast<double>(Count - 1)) + 1;
+			uint64_t seen = 0;
+			for (size_t i = 0; i < Buckets.size(); ++i)
+				if ((seen += Buckets[i]) >= rank)
+					return std::min<uint64_t>(i == 0 ? 0 : (uint64_t(1) << i) - 1, MaxNs);
+			return MaxNs;
+		}
+	};
+
+	struct lock_report
+	{
+		std::string Name;
+		uint64_t Uncontended = 0;	// acquired without waiting
+		uint64_t Contended = 0;		// had to block
+		uint64_t FailedTry = 0;		// try_lock that returned false
+		lock_histogram_report Wait;
+		lock_histogram_report Hold;	// exclusive ownership only
+		std::vector<lock_waiter> TopWaiters;
+	};
+
+	/*!
+	* @brief Counters of one named lock, shared by every mutex registered under that name.
+	*/
+	class lock_stats
+	{
+	public:
+		static constexpr size_t top_waiters = 8;
+	private:
+		std::string _name;
+		alignas(64) std::atomic<uint64_t> _uncontended = 0;
+		std::atomic<uint64_t> _contended = 0;
+		std::atomic<uint64_t> _failedTry = 0;
+		alignas(64) lock_histogram _wait;
+		alignas(64) lock_histogram _hold;
+		alignas(64) std::atomic<uint64_t> _waiterThreshold = 0;	// smallest wait kept once the table is full
+		std::mutex _waitersMutex;
+		std::vector<lock_waiter> _waiters;
+
+		static lock_histogram_report _report(const lock_histogram& h)
+		{
+			lock_histogram_report r;
+			r.Count = h.Count.load(std::memory_order_relaxed);
+			r.TotalNs = h.TotalNs.load(std::memory_order_relaxed);
+			r.MaxNs = h.MaxNs.load(std::memory_order_relaxed);
+			r.Buckets.reserve(lock_histogram::buckets);
+			for (auto& b : h.Buckets)
+				r.Buckets.push_back(b.load(std::memory_order_relaxed));
+			return r;
+		}
+	public:
+		explicit lock_stats(std::string name) : _name(std::move(name)) {}
+
+		const std::string& name() const { return _name; }
+
+		void uncontended() { _uncontended.fetch_add(1, std::memory_order_relaxed); }
+		void failed_try() { _failedTry.fetch_add(1, std::memory_order_relaxed); }
+		void held(uint64_t ns) { _hold.record(ns); }
+		void waited(uint64_t ns)
+		{
+			_contended.fetch_add(1, std::memory_order_relaxed);
+			_wait.record(ns);
+			if (ns <= _waiterThreshold.load(std::memory_order_relaxed))
+				return;
+
+			std::lock_guard lk { _waitersMutex };
+			// longest wait first
+			_waiters.insert(std::ranges::upper_bound(_waiters, ns, std::greater<>{}, &lock_waiter::WaitNs),
+				lock_waiter { ns, std::this_thread::get_id(), std::chrono::system_clock::now() });
+			if (_waiters.size() > top_waiters)
+				_waiters.pop_back();
+			if (_waiters.size() == top_waiters)
+				_waiterThreshold.store(_waiters.back().WaitNs, std::memory_order_relaxed);
+		}
+
+		lock_report report()
+		{
+			lock_report r;
+			r.Name = _name;
+			r.Uncontended = _uncontended.load(std::memory_order_relaxed);
+			r.Contended = _contended.load(std::memory_order_relaxed);
+			r.FailedTry = _failedTry.load(std::memory_order_relaxed);
+			r.Wait = _report(_wait);
+			r.Hold = _report(_hold);
+			std::lock_guard lk { _waitersMutex };
+			r.TopWaiters = _waiters;
+			return r;
+		}
+	};
+
+	/*!
+	* @brief Process-wide registry of lock_stats by name. Entries are never removed, references stay valid.
+	*/
+	class lock_profiler
+	{
+	private:
+		std::map<std::string, std::unique_ptr<lock_stats>, std::less<>> _locks;
+		std::mutex _mutex;
+	public:
+		static lock_profiler& instance()
+		{
+			static lock_profiler profiler;
+			return profiler;
+		}
+
+		lock_stats& stats(std::string_view name)
+		{
+			std::lock_guard lk { _mutex };
+			auto it = _locks.find(name);
+			if (it == _locks.end())
+				it = _locks.emplace(std::string(name), std::make_unique<lock_stats>(std::string(name))).first;
+			return *it->second;
+		}
+
+		/*!
+		* @brief Snapshot of every lock that was used, most contended (by total wait time) first.
+		*/
+		std::vector<lock_report> report()
+		{
+			std::vector<lock_report> reports;
+			{
+				std::lock_guard lk { _mutex };
+				reports.reserve(_locks.size());
+				for (auto& [name, stats] : _locks)
+					if (auto r = stats->report(); r.Uncontended + r.Contended + r.FailedTry > 0)
+						reports.push_back(std::move(r));
+			}
+			std::sort(reports.begin(), reports.end(), [](const lock_report& a, const lock_report& b) { return a.Wait.TotalNs > b.Wait.TotalNs; });
+			return reports;
+		}
+	};
+
+	/*!
+	* @brief Mutex wrapper that records, under its name, whether acquisitions had to wait, how long they waited
+	* and (for exclusive ownership) how long the mutex was held. Works with item_lock, std::lock and std::shared_lock.
+	*/
+	template<typename TMutex>
+	class profiled_mutex
+	{
+	public:
+		using mutex_type = TMutex;
+	private:
+		using clock = std::chrono::steady_clock;
+
+		mutex_type _mutex;
+		lock_stats* _stats = &lock_profiler::instance().stats("<unnamed>");
+		clock::time_point _acquired;	// written by the exclusive owner only
+
+		static uint64_t _since(clock::time_point start)
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count());
+		}
+	public:
+		profiled_mutex() = default;
+		explicit profiled_mutex(std::string_view name) : _stats(&lock_profiler::instance().stats(name)) {}
+		profiled_mutex(const profiled_mutex& rhs) = delete;
+		profiled_mutex& operator=(const profiled_mutex& rhs) = delete;
+
+		void name(std::string_view name) { _stats = &lock_profiler::instance().stats(name); }
+		const std::string& name() const { return _stats->name(); }
+
+		void lock()
+		{
+			if (_mutex.try_lock())
+				_stats->uncontended();
+			else
+			{
+				auto start = clock::now();
+				_mutex.lock();
+				_stats->waited(_since(start));
+			}
+			_acquired = clock::now();
+		}
+		bool try_lock()
+		{
+			if (!_mutex.try_lock())
+			{
+				_stats->failed_try();
+				return false;
+			}
+			_stats->uncontended();
+			_acquired = clock::now();
+			return true;
+		}
+		void unlock()
+		{
+			_stats->held(_since(_acquired));
+			_mutex.unlock();
+		}
+
+		void lock_shared() requires requires(mutex_type& m) { m.lock_shared(); }
+		{
+			if (_mutex.try_lock_shared())
+				_stats->uncontended();
+			else
+			{
+				auto start = clock::now();
+				_mutex.lock_shared();
+				_stats->waited(_since(start));
+			}
+		}
+		bool try_lock_shared() requires requires(mutex_type& m) { m.try_lock_shared(); }
+		{
+			if (!_mutex.try_lock_shared())
+			{
+				_stats->failed_try();
+				return false;
+			}
+			_stats->uncontended();
+			return true;
+		}
+		void unlock_shared() requires requires(mutex_type& m) { m.unlock_shared(); }
+		{
+			_mutex.unlock_shared();
+		}
+	};
+
+#ifdef UTILITIES_LOCK_PROFILING
+	template<typename TMutex>
+	using instrumented_mutex = profiled_mutex<TMutex>;
+#else
+	template<typename TMutex>
+	using instrumented_mutex = TMutex;
+#endif //UTILITIES_LOCK_PROFILING
+
+	/*!
+	* @brief Names the mutex in lock reports; a no-op for mutexes that are not profiled.
+	*/
+	template<typename TMutex>
+	inline void name_lock(TMutex&, std::string_view) {}
+	template<typename TMutex>
+	inline void name_lock(profiled_mutex<TMutex>& mutex, std::string_view name) { mutex.name(name); }
+}
+
+#endif //UTILITIES_LOCK_PROFILER_HPP
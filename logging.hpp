@@ -8,6 +8,8 @@
 #include <date/date.h>
 #include <nlohmann/json.hpp>
 
+#include "lock_profiler.hpp"
+
 namespace Utilities
 {	
 	inline nlohmann::json format_response_block(
@@ -84,6 +86,61 @@ namespace Utilities
 		return block;
 	}
 	
+	inline nlohmann::json format_histogram_block(lock_histogram_report const& histogram)
+	{
+		using nlohmann::json;
+
+		json block{};
+		block["count"]			= histogram.Count;
+		block["total_ns"]		= histogram.TotalNs;
+		block["max_ns"]			= histogram.MaxNs;
+		block["p50_ns"]			= histogram.quantile(0.5);
+		block["p99_ns"]			= histogram.quantile(0.99);
+		block["log2_buckets"]	= histogram.Buckets;
+
+		return block;
+	}
+
+	inline nlohmann::json format_lock_block(lock_report const& report)
+	{
+		using nlohmann::json;
+
+		json waiters = json::array();
+		for (auto const& w : report.TopWaiters)
+		{
+			json waiter{};
+			waiter["wait_ns"]		= w.WaitNs;
+			waiter["thread"]		= std::hash<std::thread::id>{}(w.Thread);
+			waiter["timestamp"]		= std::chrono::duration_cast<std::chrono::microseconds>(w.Time.time_since_epoch()).count();
+			waiters.push_back(waiter);
+		}
+
+		json block{};
+		block["name"]				= report.Name;
+		block["uncontended"]		= report.Uncontended;
+		block["contended"]			= report.Contended;
+		block["failed_try"]			= report.FailedTry;
+		block["wait"]				= format_histogram_block(report.Wait);
+		block["hold"]				= format_histogram_block(report.Hold);
+		block["top_waiters"]		= waiters;
+
+		return block;
+	}
+
+	/*!
+	* @brief Every lock known to lock_profiler, for the `extra` of format_message().
+	*/
+	inline nlohmann::json format_lock_contention_block(std::vector<lock_report> const& reports = lock_profiler::instance().report())
+	{
+		using nlohmann::json;
+
+		json block = json::array();
+		for (auto const& r : reports)
+			block.push_back(format_lock_block(r));
+
+		return block;
+	}
+
 	inline nlohmann::json format_message(
 		std::optional<std::string> message,
 		std::optional<nlohmann::json> route,
@@ -4,8 +4,18 @@
 #include "type_definitions.hpp"
 #include "item_lock.hpp"
 #include "obtainable_item.hpp"
+#include "snapshot_item.hpp"
+#include "lock_profiler.hpp"
+#include "adaptive_mutex.hpp"
+#include "mpsc_queue.hpp"
+#include "event_count.hpp"
 
 #include <queue>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+#include <atomic>
 #include <chrono>
 #include <thread>
 #include <mutex>
@@ -24,25 +34,52 @@ namespace Utilities::Threading
 
 	using Utilities::item_lock;
 	using Utilities::obtainable_item;
+	using Utilities::snapshot_item;
 
 	template<typename TContext, typename TItem>
 	struct WorkerBody
 	{
 		using context_type = TContext;
 		using item_type = TItem;
-		// buffered_list should be swapped after all done
-		//using item_queue_type = buffered_list<item_type>;
-		using item_queue_type = std::list<item_type>;
+		// lock-free inbox: any thread pushes, pop() belongs to whoever holds the worker's cvm (the worker while it runs)
+		using item_queue_type = MpscQueue<item_type>;
+		// the worker's private half of the double buffer, see Worker: filled from Queue under cvm, processed without it
+		using batch_type = std::vector<item_type>;
+		// critical sections on the body are short queue operations
+		using mutex_type = instrumented_mutex<adaptive_mutex>;
 
 		item_queue_type Queue;
+		EventCount Inbox;		// the worker sleeps on it while Queue is empty
 		context_type Context;
-		std::mutex Mutex;
+		mutex_type Mutex;
 
-		WorkerBody() = default;
+		// batching knobs, read by the worker under cvm (set them from the main callable or before run())
+		size_t BatchSize = 256;									// at most this many items per batch
+		std::chrono::microseconds MaxLatency { 0 };				// how long a partial batch may wait to fill up
+
+		WorkerBody() { name_lock(Mutex, "WorkerBody"); }
 		//WorkerBody(const WorkerBody& rhs) : Queue(rhs.Queue), Context(rhs.Context) {}
-		template<typename ...TArgs> WorkerBody(TArgs&&... args) : Queue(), Context(args...) {}
+		template<typename ...TArgs> WorkerBody(TArgs&&... args) : Queue(), Context(args...) { name_lock(Mutex, "WorkerBody"); }
+
+		/*!
+		* @brief Enqueues an item and wakes the worker; takes no lock, so it never waits for a running callable.
+		*/
+		template<typename ...TArgs>
+		void post(TArgs&&... args)
+		{
+			Queue.push(std::forward<TArgs>(args)...);
+			Inbox.notify_one();
+		}
 	};
 
+	/*!
+	* @brief Runs a callable on its own thread whenever its body has queued items.
+	* A callable taking (body_type&) pops body.Queue itself and runs with cvm held.
+	* A callable taking (body_type&, body_type::batch_type&) is batched: the worker moves up to body.BatchSize items
+	* from the inbox into its private batch under cvm, releases cvm and hands the whole batch to the callable, so
+	* synchronization is paid once per batch. With a non-zero body.MaxLatency a partial batch lingers up to that long
+	* for more items before it runs.
+	*/
 	template<typename TCallable, typename TWorkerBody>
 	class Worker
 	{
@@ -50,14 +87,18 @@ namespace Utilities::Threading
 		using callable_type = TCallable;
 		using body_type = TWorkerBody;
 		using self_type = Worker<callable_type, body_type>;
+		using batch_type = typename body_type::batch_type;
+		static constexpr bool batched = std::is_invocable_v<callable_type&, body_type&, batch_type&>;
 		//using function_type = std::function<void(body_type& body)>;
 		
 		std::mutex cvm;
 		std::condition_variable cv;
 	private:
 		thread::id _threadId;
-		bool _terminate = false;
-		bool _terminated = false;
+		std::atomic<bool> _terminate = false;
+		std::atomic<bool> _terminated = false;
+		bool _busy = false;			// guarded by cvm: a batch is being processed outside of it
+		batch_type _batch;
 
 		std::shared_ptr<std::thread> _thread;
 		callable_type _callable;
@@ -67,26 +108,71 @@ namespace Utilities::Threading
 		void _loop()
 		{
 			_threadId = std::this_thread::get_id();
+			auto& inbox = _body.get()->Inbox;
 			while (true)
-			{				
+			{
+				// announce the wait before looking at the queue, so a post() in between is not missed
+				auto key = inbox.prepare_wait();
 				unique_lock lk { cvm };
-				cv.wait(lk, [&] {
-					return !_body.get()->Queue.empty() || _terminate;
-				});
-
-				if (_terminate)
+				if (_terminate.load(std::memory_order_acquire))
 				{
-					_terminated = true;
+					inbox.cancel_wait();
+					_terminated.store(true, std::memory_order_release);
 					lk.unlock();
 					cv.notify_one();
 					return;
 				}
-				
-				_callable(*_body.get());
+				if (_body.get()->Queue.empty())
+				{
+					lk.unlock();
+					inbox.wait(key);
+					continue;
+				}
+				inbox.cancel_wait();
+
+				if constexpr (batched)
+				{
+					_collect(lk);
+					_busy = true;
+					lk.unlock();
+
+					_callable(*_body.get(), _batch);
+					_batch.clear();
+
+					lk.lock();
+					_busy = false;
+				}
+				else
+					_callable(*_body.get());
 				lk.unlock();
 				cv.notify_one();
 			}
 		}
+
+		// fills _batch from the inbox; called and returns with cvm held, releases it only while lingering
+		void _collect(unique_lock<std::mutex>& lk)
+		{
+			auto& body = *_body.get();
+			auto limit = body.BatchSize ? body.BatchSize : std::numeric_limits<size_t>::max();
+			body.Queue.pop_bulk(_batch, limit);
+			if (body.MaxLatency.count() <= 0)
+				return;
+
+			auto deadline = std::chrono::steady_clock::now() + body.MaxLatency;
+			auto pause = std::chrono::microseconds(1);
+			while (_batch.size() < limit && !_terminate.load(std::memory_order_relaxed))
+			{
+				auto now = std::chrono::steady_clock::now();
+				if (now >= deadline)
+					break;
+				_busy = true;		// the items already taken count as pending for wait()
+				lk.unlock();
+				std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(pause, deadline - now));
+				pause = std::min(pause * 2, std::chrono::microseconds(1000));
+				lk.lock();
+				body.Queue.pop_bulk(_batch, limit - _batch.size());
+			}
+		}
 	public:
 		Worker() = default;
 		Worker(callable_type callable) :
@@ -108,8 +194,9 @@ namespace Utilities::Threading
 		*/
 
 		body_type& body() { return *_body.get(); }
-		item_lock<body_type> obtain_body() { return item_lock<body_type>{ *_body.get(), *_body.get()->Mutex }; }
-		item_lock<body_type> try_obtain_body() { return item_lock<body_type>{ *_body.get(), __try_lock{}, *_body.get()->Mutex }; }
+		using body_lock = item_lock<body_type, typename body_type::mutex_type>;
+		body_lock obtain_body() { return body_lock{ *_body.get(), _body.get()->Mutex }; }
+		std::optional<body_lock> try_obtain_body() { return body_lock::try_obtain(*_body.get(), _body.get()->Mutex); }
 
 		auto thread_id() const { return _threadId;  }
 		void run()
@@ -123,19 +210,25 @@ namespace Utilities::Threading
 			_loop();
 		}
 
+		/*!
+		* @brief Wakes the worker after items were pushed to body().Queue directly; body().post() already does this.
+		*/
+		void notify() { _body.get()->Inbox.notify_one(); }
+
 		void terminate()
 		{
-			_terminate = true;
+			_terminate.store(true, std::memory_order_release);
+			_body.get()->Inbox.notify_all();
 			cv.notify_all();
 		}
-		bool is_terminated() const { return _terminated; }
+		bool is_terminated() const { return _terminated.load(std::memory_order_acquire); }
 
 		inline auto wait()
 		{
 			unique_lock lk { cvm };
 			cv.wait(lk, [&]
 			{
-				return _body.get()->Queue.empty() || _terminated;
+				return (_body.get()->Queue.empty() && !_busy) || _terminated;
 			});
 			return lk;
 		}
@@ -167,14 +260,17 @@ namespace Utilities::Threading
 		{}
 	};
 	/*!
+	* @brief TSharedContextHolder wraps the shared context: obtainable_item locks it on every access, snapshot_item
+	* suits a context that workers read on every item and the main callable updates rarely (workers keep a reader).
 	* @author multfinite
 	*/
-	template<typename TMainCallable, typename TWorkerCallable,	typename TWorkerContext, typename TWorkerItem, typename TSharedContext>
+	template<typename TMainCallable, typename TWorkerCallable,	typename TWorkerContext, typename TWorkerItem, typename TSharedContext,
+		template<typename...> class TSharedContextHolder = obtainable_item>
 	class Loop
 	{
 	public:
 		using callable_type = TMainCallable;
-		using shared_context = obtainable_item<TSharedContext>;
+		using shared_context = TSharedContextHolder<TSharedContext>;
 		using worker_context = _worker_context<TWorkerContext, shared_context>;
 		using worker_body = WorkerBody<worker_context, TWorkerItem>;
 		using worker_type = Worker<TWorkerCallable, worker_body>;
@@ -232,7 +328,7 @@ namespace Utilities::Threading
 				for (auto& pw : _workers)
 				{
 					auto& w = *pw.get();
-					w.cv.notify_one();
+					w.notify();
 				}
 				
 				for (auto& pw : _workers)
@@ -0,0 +1,86 @@
+#ifndef UTILITIES_MPSC_QUEUE_HPP
+#define UTILITIES_MPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+namespace Utilities::Threading
+{
+	/*!
+	* @brief Unbounded lock-free multi-producer single-consumer FIFO (Vyukov's intrusive queue with a stub node).
+	* push() is wait-free: one exchange and one store. pop() must only be called by one thread at a time; it can
+	* transiently report empty while a producer is between its two steps, the item shows up once that push returns.
+	*/
+	template<typename T>
+	class MpscQueue
+	{
+	private:
+		struct _node
+		{
+			std::atomic<_node*> Next = nullptr;
+			std::optional<T> Value;
+		};
+
+		alignas(64) std::atomic<_node*> _head;		// last pushed node, producers
+		alignas(64) _node* _tail;					// stub whose successor is the next to pop, consumer
+	public:
+		MpscQueue()
+		{
+			_tail = new _node();
+			_head.store(_tail, std::memory_order_relaxed);
+		}
+		MpscQueue(const MpscQueue& rhs) = delete;
+		MpscQueue& operator=(const MpscQueue& rhs) = delete;
+		~MpscQueue()
+		{
+			while (_tail)
+				delete std::exchange(_tail, _tail->Next.load(std::memory_order_relaxed));
+		}
+
+		template<typename ... TArgs>
+		void push(TArgs&&... args)
+		{
+			auto node = new _node();
+			node->Value.emplace(std::forward<TArgs>(args)...);
+			auto previous = _head.exchange(node, std::memory_order_acq_rel);
+			previous->Next.store(node, std::memory_order_release);
+		}
+
+		std::optional<T> pop()
+		{
+			auto next = _tail->Next.load(std::memory_order_acquire);
+			if (!next)
+				return {};
+			std::optional<T> value { std::move(next->Value) };
+			next->Value.reset();
+			delete std::exchange(_tail, next);
+			return value;
+		}
+
+		/*!
+		* @brief Moves up to `max` items to the back of `out` in FIFO order, returns how many. Consumer side only.
+		*/
+		template<typename TContainer>
+		size_t pop_bulk(TContainer& out, size_t max)
+		{
+			size_t count = 0;
+			for (; count < max; ++count)
+			{
+				auto next = _tail->Next.load(std::memory_order_acquire);
+				if (!next)
+					break;
+				out.push_back(std::move(*next->Value));
+				next->Value.reset();
+				delete std::exchange(_tail, next);
+			}
+			return count;
+		}
+
+		// consumer side only
+		bool empty() const { return _tail->Next.load(std::memory_order_acquire) == nullptr; }
+	};
+}
+
+#endif //UTILITIES_MPSC_QUEUE_HPP
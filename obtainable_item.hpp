@@ -1,37 +1,187 @@
 #ifndef UTILITIES_OBTAINABLE_ITEM_HPP
 #define UTILITIES_OBTAINABLE_ITEM_HPP
 
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <typeinfo>
+#include <string_view>
+#include <shared_mutex>
+#include <type_traits>
+
 #include "item_lock.hpp"
+#include "lock_profiler.hpp"
 
 namespace Utilities
 {
-	template<typename T>
+	/*!
+	* @brief Item shared between threads, obtain() locks it exclusively.
+	* The default std::mutex keeps obtain() returning item_lock<T>; read-mostly items opt into a reader/writer mutex
+	* (see shared_obtainable_item), which adds obtain_shared() for readers that don't block each other.
+	* Copies share the item and its mutex. With UTILITIES_LOCK_PROFILING the default mutex is profiled, named after T
+	* until set_lock_name() is called.
+	* Mutex and item live in one allocation, each starting on its own cache line, so taking the lock does not
+	* invalidate the line holding the item's first fields and neither shares a line with unrelated heap data.
+	*/
+	template<typename T, typename TMutex = instrumented_mutex<std::mutex>>
 	struct obtainable_item
 	{
 	public:
 		using value_type = T;
+		using mutex_type = TMutex;
 	private:
-		std::shared_ptr<value_type> _item;
-		std::shared_ptr<std::mutex> _mutex;
+		struct _storage
+		{
+			alignas(64) mutex_type Mutex;
+			alignas(64) value_type Item;
+
+			template<typename ...TArgs>
+			_storage(TArgs&&... args) : Item(std::forward<TArgs>(args)...) {}
+		};
+
+		std::shared_ptr<_storage> _block;
 	public:
 		obtainable_item() : 
-			_mutex(make_shared<std::mutex>()),
-			_item(make_shared<value_type>()) 
-		{}
+			_block(std::make_shared<_storage>())
+		{
+			Utilities::name_lock(_block->Mutex, typeid(value_type).name());
+		}
 		template<typename ...TArgs>
+			requires (sizeof...(TArgs) != 1 || !(std::is_base_of_v<obtainable_item, std::remove_cvref_t<TArgs>> || ...))
 		obtainable_item(TArgs&&... args) :
-			_mutex(make_shared<std::mutex>()),
-			_item(make_shared<value_type>(args...))
-		{}
-		obtainable_item(obtainable_item<T>&& rhs) : 
-			_item(rhs._item), _mutex(rhs._mutex)
+			_block(std::make_shared<_storage>(args...))
+		{
+			Utilities::name_lock(_block->Mutex, typeid(value_type).name());
+		}
+		obtainable_item(obtainable_item&& rhs) : 
+			_block(rhs._block)
 		{}
-		obtainable_item(const obtainable_item<T>& rhs) :
-			_item(rhs._item), _mutex(rhs._mutex)
+		obtainable_item(const obtainable_item& rhs) :
+			_block(rhs._block)
 		{}
 
-		item_lock<value_type> obtain() { return item_lock<value_type> { *_item.get(), *_mutex.get() }; }
-		value_type& direct() { return *_item.get(); }
+		item_lock<value_type, mutex_type> obtain() { return item_lock<value_type, mutex_type> { _block->Item, _block->Mutex }; }
+		std::optional<item_lock<value_type, mutex_type>> try_obtain() { return item_lock<value_type, mutex_type>::try_obtain(_block->Item, _block->Mutex); }
+		template<typename TRep, typename TPeriod>
+		std::optional<item_lock<value_type, mutex_type>> try_obtain_for(std::chrono::duration<TRep, TPeriod> const& timeout)
+		{
+			return item_lock<value_type, mutex_type>::try_obtain_for(_block->Item, timeout, _block->Mutex);
+		}
+		/*!
+		* @brief Concurrent readers don't block each other, only obtain() does.
+		*/
+		shared_item_lock<value_type, mutex_type> obtain_shared() const requires requires(mutex_type& m) { m.lock_shared(); }
+		{
+			return shared_item_lock<value_type, mutex_type> { _block->Item, _block->Mutex };
+		}
+		std::optional<shared_item_lock<value_type, mutex_type>> try_obtain_shared() const requires requires(mutex_type& m) { m.try_lock_shared(); }
+		{
+			return shared_item_lock<value_type, mutex_type>::try_obtain(_block->Item, _block->Mutex);
+		}
+		value_type& direct() { return _block->Item; }
+
+		mutex_type& mutex() { return _block->Mutex; }
+		/*!
+		* @brief Name under which the lock shows up in lock_profiler reports, shared by all copies.
+		*/
+		void set_lock_name(std::string_view name) { Utilities::name_lock(_block->Mutex, name); }
+	};
+
+	/*!
+	* @brief obtainable_item for read-mostly items: obtain_shared() readers run concurrently, at the price of a
+	* reader/writer lock on every obtain().
+	*/
+	template<typename T>
+	using shared_obtainable_item = obtainable_item<T, instrumented_mutex<std::shared_mutex>>;
+
+	/*!
+	* @brief Seqlock around a small trivially copyable value. load() never blocks writers and takes no lock:
+	* it copies the value and retries if a store() ran meanwhile. Writers are serialized by a mutex.
+	* Meant for read-mostly values of a few cache lines at most (counters, coordinates, config flags).
+	*/
+	template<typename T>
+	struct seqlock_item
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "seqlock_item requires a trivially copyable type");
+	public:
+		using value_type = T;
+	private:
+		static constexpr size_t _words = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+		alignas(64) std::atomic<uint64_t> _sequence = 0;	// odd while a store is in progress
+		std::atomic<uint64_t> _data[_words];				// copied word by word, so torn reads are not a data race
+		std::mutex _writer;
+
+		void _write(const value_type& value)
+		{
+			uint64_t buffer[_words] = {};
+			std::memcpy(buffer, &value, sizeof(T));
+			auto seq = _sequence.load(std::memory_order_relaxed);
+			_sequence.store(seq + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			for (size_t i = 0; i < _words; ++i)
+				_data[i].store(buffer[i], std::memory_order_relaxed);
+			_sequence.store(seq + 2, std::memory_order_release);
+		}
+		value_type _read_locked() const
+		{
+			uint64_t buffer[_words];
+			for (size_t i = 0; i < _words; ++i)
+				buffer[i] = _data[i].load(std::memory_order_relaxed);
+			value_type value;
+			std::memcpy(&value, buffer, sizeof(T));
+			return value;
+		}
+	public:
+		seqlock_item() requires std::is_default_constructible_v<T> : seqlock_item(value_type{}) {}
+		explicit seqlock_item(const value_type& value) { _write(value); }
+		seqlock_item(const seqlock_item& rhs) = delete;
+		seqlock_item& operator=(const seqlock_item& rhs) = delete;
+
+		value_type load() const
+		{
+			uint64_t buffer[_words];
+			while (true)
+			{
+				auto before = _sequence.load(std::memory_order_acquire);
+				if (before & 1)
+					continue;
+				for (size_t i = 0; i < _words; ++i)
+					buffer[i] = _data[i].load(std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (_sequence.load(std::memory_order_relaxed) == before)
+					break;
+			}
+			value_type value;
+			std::memcpy(&value, buffer, sizeof(T));
+			return value;
+		}
+		void store(const value_type& value)
+		{
+			std::lock_guard lk { _writer };
+			_write(value);
+		}
+		/*!
+		* @brief Read-modify-write under the writer mutex: store(f(current)).
+		*/
+		template<typename TFunction>
+		value_type update(TFunction&& f)
+		{
+			std::lock_guard lk { _writer };
+			value_type value = f(_read_locked());
+			_write(value);
+			return value;
+		}
+
+		// number of completed stores, readers can compare it to skip reloading an unchanged value
+		uint64_t version() const { return _sequence.load(std::memory_order_acquire) / 2; }
+
+		operator value_type() const { return load(); }
+		seqlock_item& operator=(const value_type& value) { store(value); return *this; }
 	};
 }
 
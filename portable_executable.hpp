@@ -12,6 +12,7 @@
 #include "file.hpp"
 #include "crc32.hpp"
 #include "exceptions.hpp"
+#include "string.ascii.hpp"
 
 namespace PECOFF
 {
@@ -261,15 +262,15 @@ namespace PECOFF
 
 			for (auto const& import : pe.Imports)
 			{
-				if (_strcmpi(import.Name.c_str(), "KERNEL32.DLL") == 0)
+				if (ascii_iequals(import.Name.c_str(), "KERNEL32.DLL"))
 				{					
 					for (auto const& thunk : import.Thunks)
 					{
-						if (_strcmpi(std::get<PortableExecutable::Thunk::NameSnap>(thunk.Snap).Name.c_str(), GetProcAddressFunctionImport) == 0)
+						if (ascii_iequals(std::get<PortableExecutable::Thunk::NameSnap>(thunk.Snap).Name.c_str(), GetProcAddressFunctionImport))
 							GetProcAddressFunc = GetProcAddressFunction(dwImageBase + thunk.Address);
-						else if (_strcmpi(std::get<PortableExecutable::Thunk::NameSnap>(thunk.Snap).Name.c_str(), LoadLibraryAFunctionImport) == 0)
+						else if (ascii_iequals(std::get<PortableExecutable::Thunk::NameSnap>(thunk.Snap).Name.c_str(), LoadLibraryAFunctionImport))
 							LoadLibraryFunc = LoadLibraryFunction(dwImageBase + thunk.Address);
-						else if (_strcmpi(std::get<PortableExecutable::Thunk::NameSnap>(thunk.Snap).Name.c_str(), FreeLibraryFunctionImport) == 0)
+						else if (ascii_iequals(std::get<PortableExecutable::Thunk::NameSnap>(thunk.Snap).Name.c_str(), FreeLibraryFunctionImport))
 							FreeLibraryFunc = FreeLibraryFunction(dwImageBase + thunk.Address);
 					}
 				}
@@ -49,16 +49,8 @@ namespace Utilities::PQXX
 		const string& clientEncoding = "UTF8"
 	) {
 		//string connstr = "host=%host% port=%port% dbname=%db% user=%dbuser% password=%dbpass%";
-		string connstr = "postgresql://%dbuser%:%dbpass%@%host%:%port%?dbname=%db%&client_encoding=%encoding%";
-		string_replace_all_templates(connstr, 
-		{
-			{ "%host%", address },
-			{ "%port%", std::to_string(port) },
-			{ "%db%", database },
-			{ "%dbuser%", username },
-			{ "%dbpass%", userpass },
-			{ "%encoding%", clientEncoding }
-		});
+		using connection_string = static_template<"postgresql://%dbuser%:%dbpass%@%host%:%port%?dbname=%db%&client_encoding=%encoding%">;
+		string connstr = connection_string::render(username, userpass, address, port, database, clientEncoding);
 		
 		return shared_ptr<connection>(new connection{ connstr });
 	}
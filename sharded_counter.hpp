@@ -0,0 +1,150 @@
+#ifndef UTILITIES_SHARDED_COUNTER_HPP
+#define UTILITIES_SHARDED_COUNTER_HPP
+
+#include <bit>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+
+namespace Utilities
+{
+	namespace _sharded
+	{
+		// threads get consecutive slot numbers on first use, so up to `slots` threads never share a slot
+		inline size_t this_thread_slot()
+		{
+			static std::atomic<size_t> next = 0;
+			thread_local size_t slot = next.fetch_add(1, std::memory_order_relaxed);
+			return slot;
+		}
+
+		inline size_t default_slots()
+		{
+			return std::bit_ceil<size_t>(std::max(1u, std::thread::hardware_concurrency()));
+		}
+
+		template<typename T>
+		struct alignas(64) slot
+		{
+			std::atomic<T> Value;
+		};
+	}
+
+	/*!
+	* @brief Counter for statistics bumped on hot paths by many threads. Each thread adds to its own cache line
+	* (one slot per hardware thread by default), load() sums the slots. Adding is a relaxed fetch_add on an
+	* uncontended line; the total is exact once writers stop, while they run it is a moment-in-time estimate.
+	*/
+	template<typename T = int64_t>
+	class sharded_counter
+	{
+		static_assert(std::is_integral_v<T>, "sharded_counter needs an integral type, see sharded_accumulator");
+	public:
+		using value_type = T;
+	private:
+		std::unique_ptr<_sharded::slot<value_type>[]> _slots;
+		size_t _mask;
+
+		std::atomic<value_type>& _mine() { return _slots[_sharded::this_thread_slot() & _mask].Value; }
+	public:
+		explicit sharded_counter(size_t slots = _sharded::default_slots()) :
+			_slots(new _sharded::slot<value_type>[std::bit_ceil(std::max<size_t>(slots, 1))]),
+			_mask(std::bit_ceil(std::max<size_t>(slots, 1)) - 1)
+		{
+			for (size_t i = 0; i <= _mask; ++i)
+				_slots[i].Value.store(0, std::memory_order_relaxed);
+		}
+		sharded_counter(const sharded_counter& rhs) = delete;
+		sharded_counter& operator=(const sharded_counter& rhs) = delete;
+
+		void add(value_type n = 1) { _mine().fetch_add(n, std::memory_order_relaxed); }
+		void sub(value_type n = 1) { _mine().fetch_sub(n, std::memory_order_relaxed); }
+		sharded_counter& operator++() { add(); return *this; }
+		sharded_counter& operator--() { sub(); return *this; }
+		sharded_counter& operator+=(value_type n) { add(n); return *this; }
+		sharded_counter& operator-=(value_type n) { sub(n); return *this; }
+
+		value_type load() const
+		{
+			value_type total = 0;
+			for (size_t i = 0; i <= _mask; ++i)
+				total += _slots[i].Value.load(std::memory_order_relaxed);
+			return total;
+		}
+		operator value_type() const { return load(); }
+
+		/*!
+		* @brief Zeroes the counter and returns what it held, without losing concurrent adds.
+		*/
+		value_type exchange()
+		{
+			value_type total = 0;
+			for (size_t i = 0; i <= _mask; ++i)
+				total += _slots[i].Value.exchange(0, std::memory_order_relaxed);
+			return total;
+		}
+
+		size_t slots() const { return _mask + 1; }
+	};
+
+	/*!
+	* @brief Generalization of sharded_counter to any associative, commutative TCombine with an identity, e.g.
+	* sum of doubles, min or max. Slots are combined with a compare-exchange loop that practically never retries,
+	* since a slot belongs to one thread unless there are more threads than slots.
+	*/
+	template<typename T, typename TCombine = std::plus<T>>
+	class sharded_accumulator
+	{
+	public:
+		using value_type = T;
+	private:
+		std::unique_ptr<_sharded::slot<value_type>[]> _slots;
+		size_t _mask;
+		value_type _identity;
+		TCombine _combine;
+	public:
+		explicit sharded_accumulator(value_type identity = value_type(), TCombine combine = TCombine(), size_t slots = _sharded::default_slots()) :
+			_slots(new _sharded::slot<value_type>[std::bit_ceil(std::max<size_t>(slots, 1))]),
+			_mask(std::bit_ceil(std::max<size_t>(slots, 1)) - 1),
+			_identity(identity), _combine(std::move(combine))
+		{
+			for (size_t i = 0; i <= _mask; ++i)
+				_slots[i].Value.store(_identity, std::memory_order_relaxed);
+		}
+		sharded_accumulator(const sharded_accumulator& rhs) = delete;
+		sharded_accumulator& operator=(const sharded_accumulator& rhs) = delete;
+
+		void add(value_type value)
+		{
+			auto& slot = _slots[_sharded::this_thread_slot() & _mask].Value;
+			auto current = slot.load(std::memory_order_relaxed);
+			while (!slot.compare_exchange_weak(current, _combine(current, value), std::memory_order_relaxed));
+		}
+		sharded_accumulator& operator+=(value_type value) { add(value); return *this; }
+
+		value_type load() const
+		{
+			value_type total = _identity;
+			for (size_t i = 0; i <= _mask; ++i)
+				total = _combine(total, _slots[i].Value.load(std::memory_order_relaxed));
+			return total;
+		}
+		operator value_type() const { return load(); }
+
+		value_type exchange()
+		{
+			value_type total = _identity;
+			for (size_t i = 0; i <= _mask; ++i)
+				total = _combine(total, _slots[i].Value.exchange(_identity, std::memory_order_relaxed));
+			return total;
+		}
+
+		size_t slots() const { return _mask + 1; }
+	};
+}
+
+#endif //UTILITIES_SHARDED_COUNTER_HPP
@@ -0,0 +1,400 @@
+#ifndef UTILITIES_SHARDED_MAP_HPP
+#define UTILITIES_SHARDED_MAP_HPP
+
+#include <bit>
+#include <mutex>
+#include <future>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <optional>
+#include <algorithm>
+#include <functional>
+#include <shared_mutex>
+#include <type_traits>
+
+#include "item_lock.hpp"
+#include "lock_profiler.hpp"
+#include "thread_pool.hpp"
+
+namespace Utilities
+{
+	/*!
+	* @brief Concurrent hash map split into independently locked shards, for lookup tables that would otherwise sit in
+	* one obtainable_item<std::map>. A key's hash picks the shard; each shard is a linear probing table with
+	* backward-shift deletion behind its own mutex, padded to its own cache lines, so threads working on different
+	* shards never touch the same lock. Readers take the shard's mutex shared when TMutex supports it.
+	* References obtained through obtain() / obtain_shared() are valid while the returned lock is held.
+	*/
+	template<typename TKey, typename TValue, typename THash = std::hash<TKey>, typename TEqual = std::equal_to<TKey>,
+		typename TMutex = instrumented_mutex<std::shared_mutex>>
+	class sharded_map
+	{
+	public:
+		using key_type = TKey;
+		using mapped_type = TValue;
+		using hasher = THash;
+		using key_equal = TEqual;
+		using mutex_type = TMutex;
+	private:
+		static constexpr size_t _initialCapacity = 16;
+		static constexpr bool _sharedLockable = requires(mutex_type& m) { m.lock_shared(); m.unlock_shared(); };
+
+		struct _entry
+		{
+			size_t Hash;
+			key_type Key;
+			mapped_type Value;
+		};
+
+		struct alignas(64) _shard
+		{
+			mutable mutex_type Mutex;
+			std::vector<uint8_t> Control;				// 0 empty, otherwise 0x80 | 7 hash bits clear of the slot (low) and shard (high) bits
+			std::vector<std::optional<_entry>> Slots;
+			size_t Size = 0;
+			size_t Mask = 0;
+
+			static uint8_t tag(size_t hash) { return static_cast<uint8_t>(0x80 | ((hash >> 40) & 0x7F)); }
+
+			void allocate(size_t capacity)
+			{
+				Control.assign(capacity, 0);
+				Slots.clear();
+				Slots.resize(capacity);
+				Mask = capacity - 1;
+			}
+
+			template<typename TKeyLike>
+			std::optional<size_t> find(const TKeyLike& key, size_t hash, const key_equal& equal) const
+			{
+				auto t = tag(hash);
+				for (size_t i = hash & Mask; Control[i] != 0; i = (i + 1) & Mask)
+					if (Control[i] == t && Slots[i]->Hash == hash && equal(Slots[i]->Key, key))
+						return i;
+				return std::nullopt;
+			}
+
+			// the key must not be present
+			template<typename TKeyArg, typename ...TArgs>
+			size_t insert(size_t hash, TKeyArg&& key, TArgs&&... args)
+			{
+				if ((Size + 1) * 8 > (Mask + 1) * 7)
+					grow();
+				size_t i = hash & Mask;
+				while (Control[i] != 0)
+					i = (i + 1) & Mask;
+				Slots[i].emplace(_entry { hash, key_type(std::forward<TKeyArg>(key)), mapped_type(std::forward<TArgs>(args)...) });
+				Control[i] = tag(hash);
+				++Size;
+				return i;
+			}
+
+			void grow()
+			{
+				auto slots = std::move(Slots);
+				allocate((Mask + 1) * 2);
+				for (auto& slot : slots)
+					if (slot)
+					{
+						size_t i = slot->Hash & Mask;
+						while (Control[i] != 0)
+							i = (i + 1) & Mask;
+						Control[i] = tag(slot->Hash);
+						Slots[i] = std::move(slot);
+					}
+			}
+
+			// backward-shift deletion keeps probe chains intact without tombstones
+			void erase(size_t i)
+			{
+				for (size_t j = (i + 1) & Mask; Control[j] != 0; j = (j + 1) & Mask)
+				{
+					size_t home = Slots[j]->Hash & Mask;
+					// move j into the hole unless its home lies cyclically in (i, j]
+					bool stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+					if (stays)
+						continue;
+					Slots[i] = std::move(Slots[j]);
+					Control[i] = Control[j];
+					i = j;
+				}
+				Slots[i].reset();
+				Control[i] = 0;
+				--Size;
+			}
+		};
+
+		std::unique_ptr<_shard[]> _shards;
+		size_t _shardCount;
+		unsigned _shardShift;
+		hasher _hash;
+		key_equal _equal;
+
+		// the user hash may be the identity (integers), spread it before taking shard and slot bits
+		template<typename TKeyLike>
+		size_t _hash_of(const TKeyLike& key) const
+		{
+			uint64_t h = static_cast<uint64_t>(_hash(key));
+			h ^= h >> 33;
+			h *= 0xff51afd7ed558ccdULL;
+			h ^= h >> 33;
+			h *= 0xc4ceb9fe1a85ec53ULL;
+			h ^= h >> 33;
+			return static_cast<size_t>(h);
+		}
+		_shard& _shard_of(size_t hash) const { return _shards[_shardShift >= 64 ? 0 : (static_cast<uint64_t>(hash) >> _shardShift)]; }
+
+		static auto _read_lock(const _shard& shard)
+		{
+			if constexpr (_sharedLockable)
+				return std::shared_lock<mutex_type> { shard.Mutex };
+			else
+				return std::unique_lock<mutex_type> { shard.Mutex };
+		}
+	public:
+		/*!
+		* @param shards rounded up to a power of two; 0 picks four per hardware thread.
+		*/
+		explicit sharded_map(size_t shards = 0, hasher hash = hasher(), key_equal equal = key_equal()) :
+			_hash(std::move(hash)), _equal(std::move(equal))
+		{
+			if (shards == 0)
+				shards = std::max<size_t>(1, std::thread::hardware_concurrency()) * 4;
+			_shardCount = std::bit_ceil(shards);
+			_shardShift = 64 - std::countr_zero(_shardCount);
+			_shards.reset(new _shard[_shardCount]);
+			for (size_t i = 0; i < _shardCount; ++i)
+			{
+				_shards[i].allocate(_initialCapacity);
+				name_lock(_shards[i].Mutex, "sharded_map");
+			}
+		}
+		sharded_map(const sharded_map& rhs) = delete;
+		sharded_map& operator=(const sharded_map& rhs) = delete;
+
+		size_t shards() const { return _shardCount; }
+
+		/*!
+		* @brief Exclusive access to the value of `key`, default-constructed if missing. Like obtainable_item::obtain(),
+		* the shard stays locked until the item_lock goes away.
+		*/
+		item_lock<mapped_type, mutex_type> obtain(const key_type& key)
+		{
+			auto hash = _hash_of(key);
+			auto& shard = _shard_of(hash);
+			shard.Mutex.lock();
+			auto i = shard.find(key, hash, _equal);
+			if (!i)
+			{
+				try { i = shard.insert(hash, key); }
+				catch (...) { shard.Mutex.unlock(); throw; }
+			}
+			return item_lock<mapped_type, mutex_type> { std::adopt_lock, shard.Slots[*i]->Value, shard.Mutex };
+		}
+		/*!
+		* @brief Exclusive access to an existing value, nothing when `key` is missing.
+		*/
+		std::optional<item_lock<mapped_type, mutex_type>> obtain_existing(const key_type& key)
+		{
+			auto hash = _hash_of(key);
+			auto& shard = _shard_of(hash);
+			std::unique_lock lk { shard.Mutex };
+			auto i = shard.find(key, hash, _equal);
+			if (!i)
+				return std::nullopt;
+			lk.release();
+			return std::optional<item_lock<mapped_type, mutex_type>> { std::in_place, std::adopt_lock, shard.Slots[*i]->Value, shard.Mutex };
+		}
+		std::optional<shared_item_lock<mapped_type, mutex_type>> obtain_shared(const key_type& key) const requires _sharedLockable
+		{
+			auto hash = _hash_of(key);
+			auto& shard = _shard_of(hash);
+			std::shared_lock lk { shard.Mutex };
+			auto i = shard.find(key, hash, _equal);
+			if (!i)
+				return std::nullopt;
+			return std::optional<shared_item_lock<mapped_type, mutex_type>> { std::in_place, shard.Slots[*i]->Value, std::move(lk) };
+		}
+
+		std::optional<mapped_type> find(const key_type& key) const
+		{
+			auto hash = _hash_of(key);
+			auto& shard = _shard_of(hash);
+			auto lk = _read_lock(shard);
+			if (auto i = shard.find(key, hash, _equal))
+				return shard.Slots[*i]->Value;
+			return std::nullopt;
+		}
+		bool contains(const key_type& key) const
+		{
+			auto hash = _hash_of(key);
+			auto& shard = _shard_of(hash);
+			auto lk = _read_lock(shard);
+			return shard.find(key, hash, _equal).has_value();
+		}
+
+		/*!
+		* @brief Inserts unless `key` is present. @returns whether it inserted.
+		*/
+		template<typename ...TArgs>
+		bool emplace(const key_type& key, TArgs&&... args)
+		{
+			auto hash = _hash_of(key);
+			auto& shard = _shard_of(hash);
+			std::lock_guard lk { shard.Mutex };
+			if (shard.find(key, hash, _equal))
+				return false;
+			shard.insert(hash, key, std::forward<TArgs>(args)...);
+			return true;
+		}
+		/*!
+		* @returns true when inserted, false when an existing value was replaced.
+		*/
+		template<typename TValueArg>
+		bool insert_or_assign(const key_type& key, TValueArg&& value)
+		{
+			auto hash = _hash_of(key);
+			auto& shard = _shard_of(hash);
+			std::lock_guard lk { shard.Mutex };
+			if (auto i = shard.find(key, hash, _equal))
+			{
+				shard.Slots[*i]->Value = std::forward<TValueArg>(value);
+				return false;
+			}
+			shard.insert(hash, key, std::forward<TValueArg>(value));
+			return true;
+		}
+		/*!
+		* @brief Calls f(value) under the shard lock, inserting a default value first if `key` is missing.
+		*/
+		template<typename TFunction>
+		decltype(auto) update(const key_type& key, TFunction&& f)
+		{
+			auto lock = obtain(key);
+			return f(lock.item());
+		}
+		bool erase(const key_type& key)
+		{
+			auto hash = _hash_of(key);
+			auto& shard = _shard_of(hash);
+			std::lock_guard lk { shard.Mutex };
+			auto i = shard.find(key, hash, _equal);
+			if (!i)
+				return false;
+			shard.erase(*i);
+			return true;
+		}
+
+		/*!
+		* @brief Inserts or assigns every (key, value) pair of `pairs`, locking each shard once.
+		*/
+		template<typename TRange>
+		void insert_bulk(TRange&& pairs)
+		{
+			std::vector<std::vector<std::pair<size_t, decltype(&*std::begin(pairs))>>> byShard(_shardCount);
+			for (auto& p : pairs)
+			{
+				auto hash = _hash_of(p.first);
+				byShard[_shardShift >= 64 ? 0 : (static_cast<uint64_t>(hash) >> _shardShift)].emplace_back(hash, &p);
+			}
+			for (size_t s = 0; s < _shardCount; ++s)
+			{
+				if (byShard[s].empty())
+					continue;
+				auto& shard = _shards[s];
+				std::lock_guard lk { shard.Mutex };
+				for (auto& [hash, p] : byShard[s])
+				{
+					if (auto i = shard.find(p->first, hash, _equal))
+						shard.Slots[*i]->Value = p->second;
+					else
+						shard.insert(hash, p->first, p->second);
+				}
+			}
+		}
+
+		/*!
+		* @brief Calls f(key, value) for every element, one shard at a time under its read lock. Not a snapshot:
+		* shards visited later may reflect changes made meanwhile. f must not call back into the map.
+		*/
+		template<typename TFunction>
+		void for_each(TFunction&& f) const
+		{
+			for (size_t s = 0; s < _shardCount; ++s)
+				_visit(_shards[s], f);
+		}
+		/*!
+		* @brief Like for_each, but f(key, value&) may modify values; each shard is locked exclusively.
+		*/
+		template<typename TFunction>
+		void for_each_mutable(TFunction&& f)
+		{
+			for (size_t s = 0; s < _shardCount; ++s)
+			{
+				auto& shard = _shards[s];
+				std::lock_guard lk { shard.Mutex };
+				for (auto& slot : shard.Slots)
+					if (slot)
+						f(std::as_const(slot->Key), slot->Value);
+			}
+		}
+		/*!
+		* @brief for_each with the shards spread over `pool`; f runs concurrently for different shards.
+		* Blocks until every shard was visited and rethrows the first exception thrown by f.
+		*/
+		template<typename TFunction>
+		void for_each_parallel(Threading::ThreadPool& pool, TFunction&& f) const
+		{
+			size_t tasks = std::min(_shardCount, pool.size() * 2);
+			std::vector<std::future<void>> done;
+			done.reserve(tasks);
+			for (size_t t = 0; t < tasks; ++t)
+				done.push_back(pool.submit([this, t, tasks, &f] {
+					for (size_t s = t; s < _shardCount; s += tasks)
+						_visit(_shards[s], f);
+				}));
+			std::exception_ptr error;
+			for (auto& d : done)
+			{
+				try { d.get(); }
+				catch (...) { if (!error) error = std::current_exception(); }
+			}
+			if (error)
+				std::rethrow_exception(error);
+		}
+
+		size_t size() const
+		{
+			size_t n = 0;
+			for (size_t s = 0; s < _shardCount; ++s)
+			{
+				auto lk = _read_lock(_shards[s]);
+				n += _shards[s].Size;
+			}
+			return n;
+		}
+		bool empty() const { return size() == 0; }
+		void clear()
+		{
+			for (size_t s = 0; s < _shardCount; ++s)
+			{
+				std::lock_guard lk { _shards[s].Mutex };
+				_shards[s].allocate(_initialCapacity);
+				_shards[s].Size = 0;
+			}
+		}
+	private:
+		template<typename TFunction>
+		void _visit(const _shard& shard, TFunction& f) const
+		{
+			auto lk = _read_lock(shard);
+			for (auto& slot : shard.Slots)
+				if (slot)
+					f(std::as_const(slot->Key), std::as_const(slot->Value));
+		}
+	};
+}
+
+#endif //UTILITIES_SHARDED_MAP_HPP
@@ -0,0 +1,232 @@
+#ifndef UTILITIES_SNAPSHOT_ITEM_HPP
+#define UTILITIES_SNAPSHOT_ITEM_HPP
+
+#include <mutex>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+namespace Utilities
+{
+	/*!
+	* @brief Read-copy-update container for read-mostly state (shared contexts, configuration).
+	* Writers copy the value, modify the copy and publish it with one atomic store; readers keep using the version they
+	* started with. Reading is wait-free: a reader handle owns a cache-line sized slot where it announces the epoch it
+	* reads in, so readers only write their own slot and never contend with each other or with writers.
+	* Replaced versions are freed once no slot announces an epoch that could still see them.
+	*/
+	template<typename T>
+	class snapshot_item
+	{
+	public:
+		using value_type = T;
+	private:
+		static constexpr uint64_t _idle = std::numeric_limits<uint64_t>::max();
+		static constexpr size_t _slotsPerBlock = 32;
+
+		struct alignas(64) _reader_slot
+		{
+			std::atomic<uint64_t> Epoch = _idle;
+			std::atomic<bool> InUse = false;
+		};
+		struct _block
+		{
+			_reader_slot Slots[_slotsPerBlock];
+			_block* Next = nullptr;		// immutable once the block is published
+		};
+		struct _retired
+		{
+			const value_type* Item;
+			uint64_t Epoch;				// last epoch in which Item was current
+		};
+
+		alignas(64) std::atomic<const value_type*> _current;
+		std::atomic<uint64_t> _epoch = 0;
+		alignas(64) std::atomic<_block*> _blocks = nullptr;
+		std::mutex _writer;
+		std::mutex _slotsMutex;
+		std::vector<_retired> _retiredItems;
+
+		_reader_slot& _acquire_slot()
+		{
+			for (auto b = _blocks.load(std::memory_order_acquire); b; b = b->Next)
+				for (auto& s : b->Slots)
+					if (!s.InUse.load(std::memory_order_relaxed) && !s.InUse.exchange(true, std::memory_order_acquire))
+						return s;
+
+			std::lock_guard lk { _slotsMutex };
+			auto b = new _block();
+			b->Slots[0].InUse.store(true, std::memory_order_relaxed);
+			b->Next = _blocks.load(std::memory_order_relaxed);
+			_blocks.store(b, std::memory_order_release);
+			return b->Slots[0];
+		}
+
+		// caller holds _writer
+		void _publish(const value_type* item)
+		{
+			auto previous = _current.exchange(item, std::memory_order_seq_cst);
+			auto epoch = _epoch.fetch_add(1, std::memory_order_seq_cst);
+			_retiredItems.push_back(_retired { previous, epoch });
+			_reclaim();
+		}
+		// caller holds _writer
+		void _reclaim()
+		{
+			if (_retiredItems.empty())
+				return;
+			uint64_t oldest = _idle;
+			for (auto b = _blocks.load(std::memory_order_acquire); b; b = b->Next)
+				for (auto& s : b->Slots)
+					oldest = std::min(oldest, s.Epoch.load(std::memory_order_seq_cst));
+			std::erase_if(_retiredItems, [oldest](const _retired& r) {
+				if (r.Epoch >= oldest)
+					return false;
+				delete r.Item;
+				return true;
+			});
+		}
+	public:
+		class reader;
+
+		/*!
+		* @brief Consistent view of the value, valid until the snapshot is destroyed. Holding it delays reclamation of
+		* replaced versions, so keep it short-lived.
+		*/
+		class snapshot
+		{
+		private:
+			reader* _reader;
+			const value_type* _item;
+		public:
+			snapshot(reader& r, const value_type* item) : _reader(&r), _item(item) {}
+			snapshot(const snapshot& rhs) = delete;
+			snapshot& operator=(const snapshot& rhs) = delete;
+			~snapshot() { _reader->_leave(); }
+
+			const value_type& item() const { return *_item; }
+			const value_type* operator->() const { return _item; }
+			const value_type& operator*() const { return *_item; }
+		};
+
+		/*!
+		* @brief Per-thread read handle, get one with obtain_reader() and keep it (e.g. in a worker's context).
+		* A handle is used by one thread at a time and must not outlive its snapshot_item. Snapshots may nest.
+		*/
+		class reader
+		{
+			friend class snapshot;
+		private:
+			snapshot_item* _owner = nullptr;
+			_reader_slot* _slot = nullptr;
+			size_t _depth = 0;
+
+			void _leave()
+			{
+				if (--_depth == 0)
+					_slot->Epoch.store(_idle, std::memory_order_release);
+			}
+		public:
+			reader() = default;
+			explicit reader(snapshot_item& owner) : _owner(&owner), _slot(&owner._acquire_slot()) {}
+			reader(reader&& rhs) noexcept :
+				_owner(std::exchange(rhs._owner, nullptr)), _slot(std::exchange(rhs._slot, nullptr)), _depth(std::exchange(rhs._depth, 0))
+			{}
+			reader& operator=(reader&& rhs) noexcept
+			{
+				if (this != &rhs)
+				{
+					release();
+					_owner = std::exchange(rhs._owner, nullptr);
+					_slot = std::exchange(rhs._slot, nullptr);
+					_depth = std::exchange(rhs._depth, 0);
+				}
+				return *this;
+			}
+			~reader() { release(); }
+
+			snapshot read()
+			{
+				if (_depth++ == 0)
+					_slot->Epoch.store(_owner->_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+				return snapshot { *this, _owner->_current.load(std::memory_order_seq_cst) };
+			}
+			/*!
+			* @brief Copy of the current value.
+			*/
+			value_type load() { return *read(); }
+
+			void release()
+			{
+				if (_slot)
+				{
+					_slot->Epoch.store(_idle, std::memory_order_release);
+					_slot->InUse.store(false, std::memory_order_release);
+				}
+				_slot = nullptr;
+				_owner = nullptr;
+				_depth = 0;
+			}
+			explicit operator bool() const { return _slot != nullptr; }
+		};
+
+		snapshot_item() : _current(new value_type()) {}
+		template<typename ...TArgs>
+		explicit snapshot_item(std::in_place_t, TArgs&&... args) : _current(new value_type(std::forward<TArgs>(args)...)) {}
+		explicit snapshot_item(value_type value) : _current(new value_type(std::move(value))) {}
+		snapshot_item(const snapshot_item& rhs) = delete;
+		snapshot_item& operator=(const snapshot_item& rhs) = delete;
+		/*!
+		* @brief No reader may be alive.
+		*/
+		~snapshot_item()
+		{
+			delete _current.load(std::memory_order_relaxed);
+			for (auto& r : _retiredItems)
+				delete r.Item;
+			for (auto b = _blocks.load(std::memory_order_relaxed); b; )
+				delete std::exchange(b, b->Next);
+		}
+
+		reader obtain_reader() { return reader { *this }; }
+
+		void store(value_type value)
+		{
+			auto item = new value_type(std::move(value));
+			std::lock_guard lk { _writer };
+			_publish(item);
+		}
+		/*!
+		* @brief Copies the current value, lets `f` modify the copy and publishes it. Writers are serialized,
+		* so concurrent updates are not lost.
+		*/
+		template<typename TFunction>
+		void update(TFunction&& f)
+		{
+			std::lock_guard lk { _writer };
+			auto item = std::make_unique<value_type>(*_current.load(std::memory_order_relaxed));
+			f(*item);
+			_publish(item.release());
+		}
+		/*!
+		* @brief Frees replaced versions that are no longer readable; store() and update() already do this.
+		*/
+		void reclaim()
+		{
+			std::lock_guard lk { _writer };
+			_reclaim();
+		}
+
+		size_t retired()
+		{
+			std::lock_guard lk { _writer };
+			return _retiredItems.size();
+		}
+	};
+}
+
+#endif //UTILITIES_SNAPSHOT_ITEM_HPP
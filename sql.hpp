@@ -23,45 +23,26 @@ namespace Utilities::SQL
 
 	string select_page(const string& what, const string& from, size_t page, size_t perpage)
 	{
-		string q = "select %what% from %from% limit %limit% offset %offset%";
-		string_replace_all_templates(q,
-		{
-			{ "%what%", what },
-			{ "%from%", from },
-			{ "%limit%", std::to_string(perpage) },
-			{ "%offset%", std::to_string(page * perpage) }
-		});
-		return q;
+		using query = static_template<"select %what% from %from% limit %limit% offset %offset%">;
+		return query::render(what, from, perpage, page * perpage);
 	}
 
 	string select_page_with_condition(const string& what, const string& from, const string& condition, size_t page, size_t perpage)
 	{
-		string q = "select %what% from %from% where %condition% limit %limit% offset %offset%";
-		string_replace_all_templates(q,
-			{
-				{ "%what%", what },
-				{ "%from%", from },
-				{ "%condition%", condition },
-				{ "%limit%", std::to_string(perpage) },
-				{ "%offset%", std::to_string(page * perpage) }
-			});
-		return q;
+		using query = static_template<"select %what% from %from% where %condition% limit %limit% offset %offset%">;
+		return query::render(what, from, condition, perpage, page * perpage);
 	}
 
 	string count_rows(const string& from)
 	{
-		string q = "select count(*) as rows from %from%";
-		string_replace_all_templates(q,
-		{
-			{ "%from%", from }
-		});
-		return q;
+		using query = static_template<"select count(*) as rows from %from%">;
+		return query::render(from);
 	}
 
 	template<typename ItBegin, typename ItEnd>
 	string where_in(const string& what, ItBegin begin, ItEnd end)
 	{
-		stringstream ss;
+		string_builder ss;
 		ss << what << " in (";
 		if (begin != end)
 		{
@@ -78,7 +59,7 @@ namespace Utilities::SQL
 	template<typename ItBegin, typename ItEnd, typename TExtractor>
 	string where_in(const string& what, ItBegin begin, ItEnd end, const TExtractor& extractor)
 	{
-		stringstream ss;
+		string_builder ss;
 		ss << what << " in (";
 		if(begin != end)
 		{
@@ -192,7 +173,7 @@ namespace Utilities::SQL
 
 		static std::string sql(const TArgs&... args)
 		{
-			stringstream ss;
+			string_builder ss;
 			ss << "call " << Name.value << "(";
 			size_t i = 0;
 			([&]
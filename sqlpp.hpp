@@ -166,40 +166,54 @@ namespace Utilities::SQLPP
 		});
 	}
 
-	template<typename sqlpp_table_type, typename container_type>
-	auto insert_json_into(DatabaseConnection& db, sqlpp_table_type& t, container_type& items, string returning = "id")
+	template<typename sqlpp_table_type, typename container_type, typename callable_type>
+	inline string _insert_json_query(sqlpp_table_type& t, container_type& items, callable_type& itemHandler, const string& returning)
 	{
-		if (items.empty())
-			construct_error_no_msg(Exceptions::REST::invalid_argument_error);
-
-		// table name
-		std::string query = "insert into %table% %columns% values %values% returning %returning%;";
-		Utilities::string_replace_all_templates(query, {
-			{ "%table%", sqlpp_table_type::_alias_t::_literal },
-			{ "%returning%", returning } 
-		});
+		static const Utilities::string_template_matcher matcher { "%table%", "%columns%", "%values%", "%returning%" };
 
 		// column insert definition
 		auto columns = all_of_as_list(t);
-		for (auto& col : columns)
-			Utilities::string_replace_all(query, "%columns%", "%b%" + col + "%e%");
-		Utilities::string_replace_all(query, "%e%%b%", ",");
-		Utilities::string_replace_all_templates(query, { { "%b%", "" }, { "%e%", "" } });
+		string columnList = "(";
+		for (size_t i = 0; i < columns.size(); ++i)
+		{
+			if (i > 0)
+				columnList += ",";
+			columnList += columns[i];
+		}
+		columnList += ")";
 
 		// items
 		stringstream ss;
-		for (json& item : items)
+		bool first = true;
+		for (json& rawItem : items)
 		{
-			ss << "%b%(";
-			for (auto& column : columns)
+			if (!first)
+				ss << ",";
+			first = false;
+			ss << "(";
+			auto&& item = itemHandler(rawItem);
+			for (size_t i = 0; i < columns.size(); ++i)
 			{
-				ss << "%b%" << (item.contains(column) ? item[column] : "default") << "%e%";
+				if (i > 0)
+					ss << ",";
+				auto& column = columns[i];
+				ss << (item.contains(column) ? item[column] : "default");
 			}
-			ss << ")%e%";
+			ss << ")";
 		}
-		Utilities::string_replace_all(query, "%values%", ss.str());
-		Utilities::string_replace_all(query, "%e%%b%", ",");
-		Utilities::string_replace_all_templates(query, { { "%b%", "" }, { "%e%", "" } });
+
+		return matcher.replace("insert into %table% %columns% values %values% returning %returning%;",
+			{ sqlpp_table_type::_alias_t::_literal, columnList, ss.str(), returning });
+	}
+
+	template<typename sqlpp_table_type, typename container_type>
+	auto insert_json_into(DatabaseConnection& db, sqlpp_table_type& t, container_type& items, string returning = "id")
+	{
+		if (items.empty())
+			construct_error_no_msg(Exceptions::REST::invalid_argument_error);
+
+		auto identity = [](json& item) -> json& { return item; };
+		std::string query = _insert_json_query(t, items, identity, returning);
 
 		auto q = sqlpp::custom_query(sqlpp::verbatim(query))
 			.with_result_type_of(sqlpp::select(sqlpp::value(0).as(sqlpp::alias::a)));
@@ -212,35 +226,7 @@ namespace Utilities::SQLPP
 		if (items.empty())
 			construct_error_no_msg(Exceptions::REST::invalid_argument_error);
 
-		// table name
-		std::string query = "insert into %table% %columns% values %values% returning %returning%;";
-		Utilities::string_replace_all_templates(query, {
-			{ "%table%", sqlpp_table_type::_alias_t::_literal },
-			{ "%returning%", returning } 
-		});
-
-		// column insert definition
-		auto columns = all_of_as_list(t);
-		for (auto& col : columns)
-			Utilities::string_replace_all(query, "%columns%", "%b%" + col + "%e%");
-		Utilities::string_replace_all(query, "%e%%b%", ",");
-		Utilities::string_replace_all_templates(query, { { "%b%", "" }, { "%e%", "" } });
-
-		// items
-		stringstream ss;
-		for (json& rawItem : items)
-		{
-			ss << "%b%(";
-			auto item = itemHandler(rawItem);
-			for (auto& column : columns)
-			{
-				ss << "%b%" << (item.contains(column) ? item[column] : "default") << "%e%";
-			}
-			ss << ")%e%";
-		}
-		Utilities::string_replace_all(query, "%values%", ss.str());
-		Utilities::string_replace_all(query, "%e%%b%", ",");
-		Utilities::string_replace_all_templates(query, { { "%b%", "" }, { "%e%", "" } });
+		std::string query = _insert_json_query(t, items, itemHandler, returning);
 
 		auto q = sqlpp::custom_query(sqlpp::verbatim(query))
 			.with_result_type_of(sqlpp::select(sqlpp::value(0).as(sqlpp::alias::a)));
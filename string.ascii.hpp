@@ -0,0 +1,225 @@
+#ifndef UTILITIES_STRING_ASCII_HPP
+#define UTILITIES_STRING_ASCII_HPP
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define UTILITIES_ASCII_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UTILITIES_ASCII_SSE2
+#endif
+
+namespace Utilities
+{
+    /*
+    * ASCII-only case handling: bytes outside 'A'..'Z' / 'a'..'z' (including UTF-8 sequences) are never changed,
+    * and no locale is consulted.
+    */
+
+    constexpr char ascii_tolower(char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c | 0x20) : c; }
+    constexpr char ascii_toupper(char c) { return (c >= 'a' && c <= 'z') ? static_cast<char>(c & ~0x20) : c; }
+
+    namespace _ascii
+    {
+        // lowercases eight bytes at once: 0x20 is added to every byte in 'A'..'Z'
+        inline uint64_t tolower8(uint64_t w)
+        {
+            constexpr uint64_t ones = 0x0101010101010101ull;
+            uint64_t heptets = w & (0x7F * ones);
+            uint64_t geA = heptets + (0x80 - 'A') * ones;
+            uint64_t gtZ = heptets + (0x7F - 'Z') * ones;
+            uint64_t upper = (geA ^ gtZ) & ~w & (0x80 * ones);
+            return w | (upper >> 2);
+        }
+        inline uint64_t load8(const char* p)
+        {
+            uint64_t w;
+            std::memcpy(&w, p, sizeof(w));
+            return w;
+        }
+        inline uint64_t load_tail(const char* p, size_t n)
+        {
+            uint64_t w = 0;
+            std::memcpy(&w, p, n);
+            return w;
+        }
+
+#if defined(UTILITIES_ASCII_SSE2)
+        inline __m128i tolower16(__m128i v)
+        {
+            auto upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+            return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+        }
+        inline __m128i toupper16(__m128i v)
+        {
+            auto lower = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('z' + 1)));
+            return _mm_andnot_si128(_mm_and_si128(lower, _mm_set1_epi8(0x20)), v);
+        }
+#endif
+#if defined(UTILITIES_ASCII_AVX2)
+        inline __m256i tolower32(__m256i v)
+        {
+            auto upper = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), v));
+            return _mm256_or_si256(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+        }
+        inline __m256i toupper32(__m256i v)
+        {
+            auto lower = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), v));
+            return _mm256_andnot_si256(_mm256_and_si256(lower, _mm256_set1_epi8(0x20)), v);
+        }
+#endif
+    }
+
+    inline void ascii_tolower_inplace(char* data, size_t size)
+    {
+        size_t i = 0;
+#if defined(UTILITIES_ASCII_AVX2)
+        for (; i + 32 <= size; i += 32)
+        {
+            auto p = reinterpret_cast<__m256i*>(data + i);
+            _mm256_storeu_si256(p, _ascii::tolower32(_mm256_loadu_si256(p)));
+        }
+#endif
+#if defined(UTILITIES_ASCII_SSE2)
+        for (; i + 16 <= size; i += 16)
+        {
+            auto p = reinterpret_cast<__m128i*>(data + i);
+            _mm_storeu_si128(p, _ascii::tolower16(_mm_loadu_si128(p)));
+        }
+#endif
+        for (; i < size; ++i)
+            data[i] = ascii_tolower(data[i]);
+    }
+    inline void ascii_toupper_inplace(char* data, size_t size)
+    {
+        size_t i = 0;
+#if defined(UTILITIES_ASCII_AVX2)
+        for (; i + 32 <= size; i += 32)
+        {
+            auto p = reinterpret_cast<__m256i*>(data + i);
+            _mm256_storeu_si256(p, _ascii::toupper32(_mm256_loadu_si256(p)));
+        }
+#endif
+#if defined(UTILITIES_ASCII_SSE2)
+        for (; i + 16 <= size; i += 16)
+        {
+            auto p = reinterpret_cast<__m128i*>(data + i);
+            _mm_storeu_si128(p, _ascii::toupper16(_mm_loadu_si128(p)));
+        }
+#endif
+        for (; i < size; ++i)
+            data[i] = ascii_toupper(data[i]);
+    }
+    inline std::string& ascii_tolower_inplace(std::string& s) { ascii_tolower_inplace(s.data(), s.size()); return s; }
+    inline std::string& ascii_toupper_inplace(std::string& s) { ascii_toupper_inplace(s.data(), s.size()); return s; }
+
+    inline bool ascii_iequals(std::string_view a, std::string_view b)
+    {
+        if (a.size() != b.size())
+            return false;
+        size_t i = 0, size = a.size();
+#if defined(UTILITIES_ASCII_AVX2)
+        for (; i + 32 <= size; i += 32)
+        {
+            auto x = _ascii::tolower32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a.data() + i)));
+            auto y = _ascii::tolower32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b.data() + i)));
+            if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)) != -1)
+                return false;
+        }
+#endif
+#if defined(UTILITIES_ASCII_SSE2)
+        for (; i + 16 <= size; i += 16)
+        {
+            auto x = _ascii::tolower16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a.data() + i)));
+            auto y = _ascii::tolower16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b.data() + i)));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xFFFF)
+                return false;
+        }
+#endif
+        for (; i + 8 <= size; i += 8)
+            if (_ascii::tolower8(_ascii::load8(a.data() + i)) != _ascii::tolower8(_ascii::load8(b.data() + i)))
+                return false;
+        for (; i < size; ++i)
+            if (ascii_tolower(a[i]) != ascii_tolower(b[i]))
+                return false;
+        return true;
+    }
+
+    inline bool ascii_istarts_with(std::string_view s, std::string_view prefix)
+    {
+        return s.size() >= prefix.size() && ascii_iequals(s.substr(0, prefix.size()), prefix);
+    }
+    inline bool ascii_iends_with(std::string_view s, std::string_view suffix)
+    {
+        return s.size() >= suffix.size() && ascii_iequals(s.substr(s.size() - suffix.size()), suffix);
+    }
+
+    /*!
+    * @brief Three-way case-insensitive comparison, same sign convention as _strcmpi / strcasecmp.
+    */
+    inline int ascii_icompare(std::string_view a, std::string_view b)
+    {
+        size_t size = a.size() < b.size() ? a.size() : b.size();
+        for (size_t i = 0; i < size; ++i)
+        {
+            auto x = static_cast<unsigned char>(ascii_tolower(a[i]));
+            auto y = static_cast<unsigned char>(ascii_tolower(b[i]));
+            if (x != y)
+                return x < y ? -1 : 1;
+        }
+        return a.size() == b.size() ? 0 : (a.size() < b.size() ? -1 : 1);
+    }
+
+    /*!
+    * @brief Case-insensitive hash, eight lowercased bytes per step.
+    */
+    inline size_t ascii_ihash(std::string_view s)
+    {
+        constexpr uint64_t k = 0x9E3779B97F4A7C15ull;
+        uint64_t h = s.size() * k;
+        size_t i = 0;
+        for (; i + 8 <= s.size(); i += 8)
+        {
+            h ^= _ascii::tolower8(_ascii::load8(s.data() + i));
+            h = (h << 31 | h >> 33) * k;
+        }
+        if (i < s.size())
+        {
+            h ^= _ascii::tolower8(_ascii::load_tail(s.data() + i, s.size() - i));
+            h = (h << 31 | h >> 33) * k;
+        }
+        h ^= h >> 29;
+        h *= 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 32;
+        return static_cast<size_t>(h);
+    }
+
+    /*!
+    * @brief Hash / equality pair for unordered containers keyed case-insensitively, e.g. HTTP header names.
+    * Both are transparent, so lookups by string_view or const char* don't build a std::string.
+    */
+    struct ascii_ihash_t
+    {
+        using is_transparent = void;
+        size_t operator()(std::string_view s) const { return ascii_ihash(s); }
+    };
+    struct ascii_iequal_to
+    {
+        using is_transparent = void;
+        bool operator()(std::string_view a, std::string_view b) const { return ascii_iequals(a, b); }
+    };
+    struct ascii_iless
+    {
+        using is_transparent = void;
+        bool operator()(std::string_view a, std::string_view b) const { return ascii_icompare(a, b) < 0; }
+    };
+}
+
+#endif // UTILITIES_STRING_ASCII_HPP
@@ -7,10 +7,46 @@
 #include <list>
 #include <map>
 #include <algorithm>
+#include <string_view>
+#include <iterator>
+#include <cstring>
+#include <bit>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <initializer_list>
+#include <charconv>
+#include <type_traits>
+#include <functional>
+#include <memory_resource>
+
+#include <version>
+
+#include "string.ascii.hpp"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// string_fmt* use std::format. Without <format> (GCC 12) they are only available when the includer opts into {fmt}
+// by defining UTILITIES_STRING_FORMAT_FMT and linking fmt (or defining FMT_HEADER_ONLY); string_format always works.
+#if defined(__cpp_lib_format)
+#include <format>
+#undef UTILITIES_STRING_FORMAT_FMT
+#define UTILITIES_STRING_FORMAT_STD
+#elif defined(UTILITIES_STRING_FORMAT_FMT)
+#include <fmt/format.h>
+#endif
 
 namespace Utilities
 {    
     #define nameof(x) #x
+
+    /*!
+    * @brief char string with any allocator, so helpers writing into caller buffers accept std::string and std::pmr::string alike.
+    */
+    template<typename TAlloc>
+    using basic_char_string = std::basic_string<char, std::char_traits<char>, TAlloc>;
     #define stringify(x) #x
     
     template<size_t N>
@@ -22,39 +58,261 @@ namespace Utilities
     
         char value[N];
 
-        operator std::string_view() const { return std::string_view{ value, N }; }
-        operator const char*() const { return &value; }
+        static constexpr size_t size() { return N - 1; }
+        constexpr std::string_view view() const { return std::string_view{ value, N - 1 }; }
+        constexpr uint64_t hash() const;
+
+        constexpr operator std::string_view() const { return view(); }
+        constexpr operator const char*() const { return value; }
+    };
+
+    /*!
+    * @brief 64-bit FNV-1a, usable in constant expressions.
+    */
+    constexpr uint64_t string_hash(std::string_view s, uint64_t seed = 0xCBF29CE484222325ull)
+    {
+        uint64_t h = seed;
+        for (char c : s)
+        {
+            h ^= static_cast<unsigned char>(c);
+            h *= 0x100000001B3ull;
+        }
+        return h;
+    }
+
+    template<size_t N>
+    constexpr uint64_t string_literal<N>::hash() const { return string_hash(view()); }
+
+    /*!
+    * @brief Hash of a string_literal computed at compile time: string_hash_of<"GET">.
+    */
+    template<string_literal S>
+    inline constexpr uint64_t string_hash_of = string_hash(S.view());
+
+    /*!
+    * @brief Switch-on-string over a fixed key set with a perfect hash generated at compile time.
+    * Hash-and-displace (CHD): keys are grouped into buckets by their hash, each bucket gets the displacement
+    * that moves all its keys to free slots. Building takes linear time in practice, so hundreds of keys compile
+    * quickly. A lookup is one hash, two table loads and one comparison.
+    *
+    *   using methods = string_switch<"GET", "POST", "PUT">;
+    *   switch (methods::index(method))
+    *   {
+    *   case methods::of<"GET">: ...
+    *   case methods::npos: ...
+    *   }
+    */
+    template<string_literal... Keys>
+    struct string_switch
+    {
+        static constexpr size_t count = sizeof...(Keys);
+        static constexpr size_t npos = count;
+    private:
+        static constexpr std::array<std::string_view, count> _keys { Keys.view()... };
+
+        static constexpr size_t _pow2(size_t n)
+        {
+            size_t p = 1;
+            while (p < n)
+                p <<= 1;
+            return p;
+        }
+        static constexpr size_t _size = _pow2(count + count / 4 + 1);     // load factor at most 0.8
+        static constexpr size_t _buckets = _pow2(count / 2 + 1);          // about two keys per bucket
+        static constexpr uint32_t _maxDisplacement = 1u << 20;
+
+        static constexpr size_t _bucket(uint64_t h) { return static_cast<size_t>(h >> 32) & (_buckets - 1); }
+        static constexpr size_t _slot(uint64_t h, uint32_t displacement)
+        {
+            // splitmix64 finalizer, so every displacement gives an independent slot
+            uint64_t x = h + (displacement + 1) * 0x9E3779B97F4A7C15ull;
+            x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+            x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+            return static_cast<size_t>(x ^ (x >> 31)) & (_size - 1);
+        }
+
+        struct _layout
+        {
+            std::array<uint32_t, _buckets> Displacements {};
+            std::array<size_t, _size> Slots {};
+        };
+        static constexpr _layout _build()
+        {
+            // counting sort by bucket, bucket b holds members[first[b] .. first[b + 1])
+            std::array<uint64_t, count + 1> hashes {};
+            std::array<size_t, _buckets + 1> first {};
+            for (size_t k = 0; k < count; ++k)
+            {
+                hashes[k] = string_hash(_keys[k]);
+                ++first[_bucket(hashes[k]) + 1];
+            }
+            size_t largest = 0;
+            for (size_t b = 0; b < _buckets; ++b)
+            {
+                largest = (std::max)(largest, first[b + 1]);
+                first[b + 1] += first[b];
+            }
+            std::array<size_t, count + 1> members {};
+            auto fill = first;
+            for (size_t k = 0; k < count; ++k)
+                members[fill[_bucket(hashes[k])]++] = k;
+            // equal keys have equal hashes and share a bucket, comparing within buckets keeps this linear
+            for (size_t b = 0; b < _buckets; ++b)
+                for (size_t i = first[b]; i < first[b + 1]; ++i)
+                    for (size_t j = first[b]; j < i; ++j)
+                        if (hashes[members[i]] == hashes[members[j]] && _keys[members[i]] == _keys[members[j]])
+                            throw "string_switch: duplicate key";
+
+            _layout l;
+            for (auto& slot : l.Slots)
+                slot = npos;
+            // fullest buckets first, while the table is still mostly empty
+            for (size_t size = largest; size > 0; --size)
+            {
+                for (size_t b = 0; b < _buckets; ++b)
+                {
+                    if (first[b + 1] - first[b] != size)
+                        continue;
+                    std::array<size_t, count + 1> taken {};
+                    for (uint32_t d = 0; ; ++d)
+                    {
+                        if (d == _maxDisplacement)
+                            throw "string_switch: no perfect hash found";
+                        size_t placed = 0;
+                        for (; placed < size; ++placed)
+                        {
+                            auto slot = _slot(hashes[members[first[b] + placed]], d);
+                            bool free = l.Slots[slot] == npos;
+                            for (size_t i = 0; i < placed && free; ++i)
+                                free = taken[i] != slot;
+                            if (!free)
+                                break;
+                            taken[placed] = slot;
+                        }
+                        if (placed < size)
+                            continue;
+                        l.Displacements[b] = d;
+                        for (size_t i = 0; i < size; ++i)
+                            l.Slots[taken[i]] = members[first[b] + i];
+                        break;
+                    }
+                }
+            }
+            return l;
+        }
+        static constexpr _layout _table = _build();
+
+        template<string_literal Key>
+        static constexpr size_t _find()
+        {
+            for (size_t k = 0; k < count; ++k)
+                if (_keys[k] == Key.view())
+                    return k;
+            return npos;
+        }
+    public:
+        /*!
+        * @brief Position of Key in the key list, a compile error if it is not there.
+        */
+        template<string_literal Key>
+        static constexpr size_t of = []
+        {
+            constexpr size_t index = _find<Key>();
+            static_assert(index != npos, "string_switch: key is not in the set");
+            return index;
+        }();
+
+        static constexpr std::string_view key(size_t index) { return _keys[index]; }
+
+        /*!
+        * @return position of s in the key list or npos.
+        */
+        static constexpr size_t index(std::string_view s)
+        {
+            auto h = string_hash(s);
+            size_t k = _table.Slots[_slot(h, _table.Displacements[_bucket(h)])];
+            return k != npos && _keys[k] == s ? k : npos;
+        }
+        static constexpr bool contains(std::string_view s) { return index(s) != npos; }
     };
     
     /* https://stackoverflow.com/questions/2342162/stdstring-formatting-like-sprintf */
     template<typename ... Args>
     std::string string_format(const std::string& format, Args ... args)
     {
-        int size_s = std::snprintf(nullptr, 0, format.c_str(), args ...) + 1; // Extra space for '\0'
-        if (size_s <= 0) { throw std::runtime_error("Error during formatting."); }
+        // most results fit the stack buffer, then one snprintf is enough
+        char stack[256];
+        int size_s = std::snprintf(stack, sizeof(stack), format.c_str(), args ...);
+        if (size_s < 0) { throw std::runtime_error("Error during formatting."); }
         auto size = static_cast<size_t>(size_s);
-        std::unique_ptr<char[]> buf(new char[size]);
-        std::snprintf(buf.get(), size, format.c_str(), args ...);
-        return std::string(buf.get(), buf.get() + size - 1); // We don't want the '\0' inside
+        if (size < sizeof(stack))
+            return std::string(stack, size);
+        std::string buf(size, '\0');
+        std::snprintf(buf.data(), size + 1, format.c_str(), args ...);
+        return buf;
+    }
+
+#if defined(UTILITIES_STRING_FORMAT_STD) || defined(UTILITIES_STRING_FORMAT_FMT)
+#if defined(UTILITIES_STRING_FORMAT_STD)
+    namespace _format = std;
+#else
+    namespace _format = fmt;
+#endif
+    /*!
+    * @brief std::format format string, checked against the argument types at compile time.
+    */
+    template<typename ...TArgs>
+    using format_string = _format::format_string<TArgs...>;
+
+    /*!
+    * @brief Type-safe replacement of string_format with std::format syntax ("{}: {}").
+    */
+    template<typename ...TArgs>
+    inline std::string string_fmt(format_string<TArgs...> format, TArgs&&... args)
+    {
+        return _format::format(format, std::forward<TArgs>(args)...);
+    }
+    /*!
+    * @brief Writes straight into an output iterator.
+    */
+    template<typename TOutputIt, typename ...TArgs>
+    inline TOutputIt string_fmt_to(TOutputIt out, format_string<TArgs...> format, TArgs&&... args)
+    {
+        return _format::format_to(out, format, std::forward<TArgs>(args)...);
     }
+    /*!
+    * @brief Appends to a caller-owned buffer. Clearing and reusing it avoids allocating per call.
+    */
+    template<typename TAlloc, typename ...TArgs>
+    inline basic_char_string<TAlloc>& string_fmt_append(basic_char_string<TAlloc>& buffer, format_string<TArgs...> format, TArgs&&... args)
+    {
+        _format::format_to(std::back_inserter(buffer), format, std::forward<TArgs>(args)...);
+        return buffer;
+    }
+#endif
     
     inline std::string string_tolower(const std::string& str)
     {
         std::string s = str;
-        std::transform(
-            s.begin(), s.end(), s.begin(),
-            [](unsigned char c) { return std::tolower(c); }
-        );
+        ascii_tolower_inplace(s);
+        return s;
+    }
+    inline std::pmr::string string_tolower(std::string_view str, std::pmr::memory_resource* resource)
+    {
+        std::pmr::string s { str, resource };
+        ascii_tolower_inplace(s.data(), s.size());
         return s;
     }
 
     /* https://stackoverflow.com/questions/5878775/how-to-find-and-replace-string */
-    inline void string_replace_all(
-        std::string& s,
-        const std::string& toReplace,
-        const std::string& replaceWith
+    template<typename TAlloc>
+    inline void _string_replace_all(
+        basic_char_string<TAlloc>& s,
+        std::string_view toReplace,
+        std::string_view replaceWith
     ) {
-        std::string buf;
+        // the buffer comes from the same allocator, so a pmr string stays inside its arena
+        basic_char_string<TAlloc> buf { s.get_allocator() };
         std::size_t pos = 0;
         std::size_t prevPos;
     
@@ -74,67 +332,759 @@ namespace Utilities
         buf.append(s, prevPos, s.size() - prevPos);
         s.swap(buf);
     }
+    inline void string_replace_all(
+        std::string& s,
+        const std::string& toReplace,
+        const std::string& replaceWith
+    ) {
+        _string_replace_all(s, toReplace, replaceWith);
+    }
+    inline void string_replace_all(
+        std::pmr::string& s,
+        std::string_view toReplace,
+        std::string_view replaceWith
+    ) {
+        _string_replace_all(s, toReplace, replaceWith);
+    }
     
+    /*!
+    * @brief Aho-Corasick automaton over a fixed key set, substitutes every key in one pass over the input.
+    * Build it once per key set and reuse it. At each position the longest key ending there wins,
+    * matches never overlap and replacement values are not scanned again.
+    */
+    class string_template_matcher
+    {
+    private:
+        static constexpr uint32_t _none = UINT32_MAX;
+
+        std::vector<std::string> _keys;
+        std::array<uint8_t, 256> _class {};     // byte -> column, 0 for bytes no key contains
+        size_t _classes = 1;
+        std::vector<uint32_t> _next;            // state * _classes + class -> state
+        std::vector<uint32_t> _match;           // state -> index of the longest key ending here
+
+        void _build()
+        {
+            for (auto& key : _keys)
+                for (unsigned char c : key)
+                    if (_class[c] == 0)
+                        _class[c] = static_cast<uint8_t>(_classes++);
+
+            _next.assign(_classes, _none);
+            _match.assign(1, _none);
+            for (uint32_t k = 0; k < _keys.size(); ++k)
+            {
+                if (_keys[k].empty())
+                    continue;
+                uint32_t state = 0;
+                for (unsigned char c : _keys[k])
+                {
+                    auto& next = _next[state * _classes + _class[c]];
+                    if (next == _none)
+                    {
+                        next = static_cast<uint32_t>(_match.size());
+                        _match.push_back(_none);
+                        _next.resize(_next.size() + _classes, _none);
+                    }
+                    state = _next[state * _classes + _class[c]];
+                }
+                if (_match[state] == _none)
+                    _match[state] = k;
+            }
+
+            // breadth-first: resolve failure links into a full transition table
+            std::vector<uint32_t> fail(_match.size(), 0), queue;
+            queue.reserve(_match.size());
+            for (size_t c = 0; c < _classes; ++c)
+            {
+                auto& next = _next[c];
+                if (next == _none)
+                    next = 0;
+                else
+                    queue.push_back(next);
+            }
+            for (size_t i = 0; i < queue.size(); ++i)
+            {
+                uint32_t state = queue[i];
+                if (_match[state] == _none)
+                    _match[state] = _match[fail[state]];
+                for (size_t c = 0; c < _classes; ++c)
+                {
+                    auto& next = _next[state * _classes + c];
+                    auto fallback = _next[fail[state] * _classes + c];
+                    if (next == _none)
+                        next = fallback;
+                    else
+                    {
+                        fail[next] = fallback;
+                        queue.push_back(next);
+                    }
+                }
+            }
+        }
+    public:
+        string_template_matcher(std::initializer_list<std::string_view> keys) :
+            _keys(keys.begin(), keys.end())
+        {
+            _build();
+        }
+        template<typename TContainer>
+        explicit string_template_matcher(const TContainer& keys)
+        {
+            for (auto& key : keys)
+            {
+                if constexpr (requires { key.first; })
+                    _keys.emplace_back(key.first);
+                else
+                    _keys.emplace_back(key);
+            }
+            _build();
+        }
+
+        size_t size() const { return _keys.size(); }
+        const std::string& key(size_t index) const { return _keys[index]; }
+
+        /*!
+        * @param values indexable like the keys, values[i] replaces key(i).
+        * @param out receives the result. Its capacity is reused.
+        */
+        template<typename TValues, typename TAlloc>
+        void replace(std::string_view s, const TValues& values, basic_char_string<TAlloc>& out) const
+        {
+            if (std::size(values) < _keys.size())
+                throw std::invalid_argument("string_template_matcher: fewer values than keys");
+
+            struct match { size_t Begin; uint32_t Key; };
+            thread_local std::vector<match> matches;
+            matches.clear();
+
+            size_t size = s.size();
+            uint32_t state = 0;
+            for (size_t i = 0; i < s.size(); ++i)
+            {
+                state = _next[state * _classes + _class[static_cast<unsigned char>(s[i])]];
+                uint32_t k = _match[state];
+                if (k == _none)
+                    continue;
+                size_t length = _keys[k].size();
+                matches.push_back({ i + 1 - length, k });
+                size = size - length + std::string_view(values[k]).size();
+                state = 0;
+            }
+
+            out.clear();
+            out.reserve(size);
+            size_t last = 0;
+            for (auto& m : matches)
+            {
+                out.append(s, last, m.Begin - last);
+                out.append(std::string_view(values[m.Key]));
+                last = m.Begin + _keys[m.Key].size();
+            }
+            out.append(s, last, s.size() - last);
+        }
+        template<typename TValues>
+        std::string replace(std::string_view s, const TValues& values) const
+        {
+            std::string out;
+            replace(s, values, out);
+            return out;
+        }
+        std::string replace(std::string_view s, std::initializer_list<std::string_view> values) const
+        {
+            std::string out;
+            replace(s, std::vector<std::string_view>(values), out);
+            return out;
+        }
+
+        /*!
+        * @brief Looks each key up in `replacements`, missing keys are replaced with themselves.
+        */
+        template<typename TAlloc>
+        void replace(std::string_view s, const std::map<std::string, std::string>& replacements, basic_char_string<TAlloc>& out) const
+        {
+            std::vector<std::string_view> values;
+            values.reserve(_keys.size());
+            for (auto& key : _keys)
+            {
+                auto it = replacements.find(key);
+                values.push_back(it == replacements.end() ? std::string_view(key) : std::string_view(it->second));
+            }
+            replace(s, values, out);
+        }
+    };
+
+    struct _template_segment
+    {
+        static constexpr size_t literal = SIZE_MAX;
+
+        size_t Offset = 0;      // into the template source; for slots the name without markers
+        size_t Length = 0;
+        size_t Slot = literal;
+    };
+
+    /*
+    * Splits `source` into literal and %name% slot segments. Slots are numbered by the first appearance
+    * of their name, so a name used twice takes one argument. A marker not closing a [A-Za-z0-9_]+ name is literal text.
+    */
+    template<typename TSegments>
+    constexpr size_t _template_parse(std::string_view source, char marker, TSegments& segments)
+    {
+        auto is_name = [](char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_'; };
+        size_t slots = 0;
+        size_t literal = 0;
+        size_t i = 0;
+        while (i < source.size())
+        {
+            if (source[i] != marker)
+            {
+                ++i;
+                continue;
+            }
+            size_t end = i + 1;
+            while (end < source.size() && is_name(source[end]))
+                ++end;
+            if (end == i + 1 || end >= source.size() || source[end] != marker)
+            {
+                i = end;
+                continue;
+            }
+
+            if (i > literal)
+                segments.push_back(_template_segment{ literal, i - literal });
+            _template_segment slot { i + 1, end - i - 1, slots };
+            for (size_t s = 0; s < segments.size(); ++s)
+            {
+                auto& other = segments[s];
+                if (other.Slot != _template_segment::literal && source.substr(other.Offset, other.Length) == source.substr(slot.Offset, slot.Length))
+                {
+                    slot.Slot = other.Slot;
+                    break;
+                }
+            }
+            if (slot.Slot == slots)
+                ++slots;
+            segments.push_back(slot);
+            i = literal = end + 1;
+        }
+        if (source.size() > literal)
+            segments.push_back(_template_segment{ literal, source.size() - literal });
+        return slots;
+    }
+
+    /*
+    * One rendering argument as text: string-like values are viewed, numbers are formatted into the inline buffer.
+    */
+    struct _template_argument
+    {
+        char Buffer[32];
+        std::string_view View;
+
+        template<typename T>
+        _template_argument(const T& value)
+        {
+            if constexpr (std::is_convertible_v<const T&, std::string_view>)
+                View = value;
+            else if constexpr (std::is_same_v<T, bool>)     // to_chars(bool) is deleted
+                View = value ? "true" : "false";
+            else if constexpr (std::is_same_v<T, char>)
+                View = { Buffer, (Buffer[0] = value, 1u) };
+            else
+            {
+                static_assert(std::is_arithmetic_v<T>, "template argument must be string-like or arithmetic");
+                auto r = std::to_chars(Buffer, Buffer + sizeof(Buffer), value);
+                View = { Buffer, static_cast<size_t>(r.ptr - Buffer) };
+            }
+        }
+        _template_argument(const _template_argument& rhs) = delete;
+    };
+
+    template<typename TAlloc, typename TSegments>
+    inline void _template_render(basic_char_string<TAlloc>& out, std::string_view source, const TSegments& segments, size_t count, size_t literalSize, const std::string_view* args)
+    {
+        size_t size = literalSize;
+        for (size_t i = 0; i < count; ++i)
+            if (segments[i].Slot != _template_segment::literal)
+                size += args[segments[i].Slot].size();
+
+        out.clear();
+        out.reserve(size);
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto& segment = segments[i];
+            if (segment.Slot == _template_segment::literal)
+                out.append(source.data() + segment.Offset, segment.Length);
+            else
+                out.append(args[segment.Slot]);
+        }
+    }
+
+    /*
+    * Map from slot names to string-like values: std::map<std::string, std::string> with or without std::less<>,
+    * unordered_map and the like.
+    */
+    template<typename TMap>
+    concept _template_named_arguments = requires(const TMap& map)
+    {
+        typename TMap::key_type;
+        typename TMap::mapped_type;
+        requires std::is_convertible_v<const typename TMap::mapped_type&, std::string_view>;
+        map.end();
+    };
+
+    /*!
+    * @brief Template parsed once into literal and %slot% segments, rendered with one append per segment.
+    * Positional arguments follow the first appearance of each slot name; numbers are formatted with to_chars.
+    */
+    class compiled_template
+    {
+    private:
+        std::string _source;
+        std::vector<_template_segment> _segments;
+        std::vector<size_t> _names;     // slot -> its first segment, offsets keep copies valid
+        size_t _literalSize = 0;
+    public:
+        explicit compiled_template(std::string_view source, char marker = '%') :
+            _source(source)
+        {
+            _names.resize(_template_parse(_source, marker, _segments));
+            for (size_t i = _segments.size(); i-- > 0; )
+            {
+                auto& segment = _segments[i];
+                if (segment.Slot == _template_segment::literal)
+                    _literalSize += segment.Length;
+                else
+                    _names[segment.Slot] = i;
+            }
+        }
+
+        size_t slots() const { return _names.size(); }
+        std::string_view name(size_t slot) const
+        {
+            auto& segment = _segments[_names[slot]];
+            return std::string_view(_source).substr(segment.Offset, segment.Length);
+        }
+
+        template<typename TAlloc, typename ...TArgs>
+        void render_to(basic_char_string<TAlloc>& out, const TArgs&... args) const
+        {
+            if (sizeof...(TArgs) != _names.size())
+                throw std::invalid_argument("compiled_template: argument count does not match slot count");
+            const _template_argument converted[] = { args..., std::string_view{} };
+            std::string_view views[sizeof...(TArgs) + 1];
+            for (size_t i = 0; i < sizeof...(TArgs); ++i)
+                views[i] = converted[i].View;
+            _template_render(out, _source, _segments, _segments.size(), _literalSize, views);
+        }
+        template<typename ...TArgs>
+        std::string render(const TArgs&... args) const
+        {
+            std::string out;
+            render_to(out, args...);
+            return out;
+        }
+
+        /*!
+        * @brief Slots missing from `named` are rendered as their original %name% text.
+        * Maps without heterogeneous lookup get one key_type built per slot (short names stay in SSO).
+        */
+        template<typename TAlloc, _template_named_arguments TMap>
+        void render_to(basic_char_string<TAlloc>& out, const TMap& named) const
+        {
+            static constexpr size_t inlineSlots = 16;
+            std::string_view stack[inlineSlots];
+            std::vector<std::string_view> heap;
+            auto args = _names.size() <= inlineSlots ? stack : (heap.resize(_names.size()), heap.data());
+            for (size_t slot = 0; slot < _names.size(); ++slot)
+            {
+                auto name = this->name(slot);
+                auto it = [&]
+                {
+                    if constexpr (requires { named.find(name); })
+                        return named.find(name);
+                    else
+                        return named.find(typename TMap::key_type(name));
+                }();
+                // the name views into _source, widening it by one char each side gives back "%name%"
+                args[slot] = it != named.end() ? std::string_view(it->second) : std::string_view(name.data() - 1, name.size() + 2);
+            }
+            _template_render(out, _source, _segments, _segments.size(), _literalSize, args);
+        }
+        template<_template_named_arguments TMap>
+        std::string render(const TMap& named) const
+        {
+            std::string out;
+            render_to(out, named);
+            return out;
+        }
+    };
+
+    template<size_t N>
+    struct _static_template_layout
+    {
+        std::array<_template_segment, N> Segments {};
+        size_t Count = 0;
+        size_t Slots = 0;
+        size_t LiteralSize = 0;
+
+        constexpr void push_back(_template_segment segment) { Segments[Count++] = segment; }
+        constexpr size_t size() const { return Count; }
+        constexpr const _template_segment& operator[](size_t i) const { return Segments[i]; }
+    };
+
+    /*!
+    * @brief compiled_template whose parsing happens at compile time.
+    * Usage: static_template<"select %what% from %from%">::render(what, from)
+    */
+    template<string_literal Source, char Marker = '%'>
+    struct static_template
+    {
+        static constexpr std::string_view source() { return { Source.value, sizeof(Source.value) - 1 }; }
+
+        static constexpr auto layout = []
+        {
+            _static_template_layout<sizeof(Source.value)> l;
+            l.Slots = _template_parse(source(), Marker, l);
+            for (size_t i = 0; i < l.Count; ++i)
+                if (l.Segments[i].Slot == _template_segment::literal)
+                    l.LiteralSize += l.Segments[i].Length;
+            return l;
+        }();
+
+        template<typename TAlloc, typename ...TArgs>
+        static void render_to(basic_char_string<TAlloc>& out, const TArgs&... args)
+        {
+            static_assert(sizeof...(TArgs) == layout.Slots, "argument count does not match slot count");
+            const _template_argument converted[] = { args..., std::string_view{} };
+            std::string_view views[sizeof...(TArgs) + 1];
+            for (size_t i = 0; i < sizeof...(TArgs); ++i)
+                views[i] = converted[i].View;
+            _template_render(out, source(), layout.Segments, layout.Count, layout.LiteralSize, views);
+        }
+        template<typename ...TArgs>
+        static std::string render(const TArgs&... args)
+        {
+            std::string out;
+            render_to(out, args...);
+            return out;
+        }
+    };
+
+    /*!
+    * @brief Matcher for the key set of `replacements`, built once and kept in a small per-thread LRU, so repeated
+    * calls with the same keys, however few, only compare the keys. Callers with a fixed key set can also keep their
+    * own string_template_matcher.
+    */
+    inline const string_template_matcher& _template_matcher_for(const std::map<std::string, std::string>& replacements)
+    {
+        static constexpr size_t capacity = 8;
+        thread_local std::vector<std::unique_ptr<string_template_matcher>> cache;
+        auto same = [&replacements](const string_template_matcher& matcher)
+        {
+            if (matcher.size() != replacements.size())
+                return false;
+            size_t i = 0;
+            for (auto& kvp : replacements)
+                if (matcher.key(i++) != kvp.first)
+                    return false;
+            return true;
+        };
+        for (size_t i = 0; i < cache.size(); ++i)
+        {
+            if (!same(*cache[i]))
+                continue;
+            std::rotate(cache.begin(), cache.begin() + i, cache.begin() + i + 1);
+            return *cache.front();
+        }
+        if (cache.size() == capacity)
+            cache.pop_back();
+        cache.insert(cache.begin(), std::make_unique<string_template_matcher>(replacements));
+        return *cache.front();
+    }
+
+    /*!
+    * @brief Replaces every key of `replacements` in one pass over `s`, for maps of any size (see
+    * string_template_matcher): at each position the longest key wins, matches don't overlap and substituted values
+    * are never scanned again, so {"%a%" -> "%b%", "%b%" -> "X"} turns "%a%" into "%b%".
+    */
     inline std::string string_replace_all_templates(
         const std::string& s,
         const std::map<std::string, std::string>& replacements
     ) {
-        std::string str = s;
+        thread_local std::vector<std::string_view> values;
+        values.clear();
         for (auto& kvp : replacements)
-        {
-            string_replace_all(str, kvp.first, kvp.second);
-        }
-        return str;
+            values.push_back(kvp.second);
+        std::string out;
+        _template_matcher_for(replacements).replace(s, values, out);
+        return out;
     }
     inline void string_replace_all_templates(
        std::string& s,
        const std::map<std::string, std::string>& replacements
     ) {
+        s = string_replace_all_templates(static_cast<const std::string&>(s), replacements);
+    }
+    inline std::pmr::string string_replace_all_templates(
+        std::string_view s,
+        const std::map<std::string, std::string>& replacements,
+        std::pmr::memory_resource* resource
+    ) {
+        std::pmr::string out { resource };
+        std::pmr::vector<std::string_view> values { resource };
+        values.reserve(replacements.size());
         for (auto& kvp : replacements)
+            values.push_back(kvp.second);
+        _template_matcher_for(replacements).replace(s, values, out);
+        return out;
+    }
+    
+    /*!
+    * @brief Position of the first `c` in [first, last) or `last`. AVX2 when available, memchr otherwise.
+    */
+    inline const char* string_find_char(const char* first, const char* last, char c)
+    {
+#ifdef __AVX2__
+        const __m256i needle = _mm256_set1_epi8(c);
+        for (; last - first >= 32; first += 32)
         {
-            string_replace_all(s, kvp.first, kvp.second);
+            auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+            auto mask = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+            if (mask != 0)
+                return first + std::countr_zero(mask);
         }
+#endif
+        auto found = static_cast<const char*>(std::memchr(first, c, last - first));
+        return found ? found : last;
     }
-    
-    std::list<std::string> string_split(const std::string& str, const std::string& delimiter)
+
+    inline size_t string_find(std::string_view s, std::string_view delimiter, size_t pos = 0)
     {
-        std::string s = str;
-        size_t pos_start = 0, pos_end, delim_len = delimiter.length();
-        std::string token;
-        std::list<std::string> res;
-    
-        while ((pos_end = s.find(delimiter, pos_start)) != std::string::npos) 
+        if (pos > s.size())
+            return std::string_view::npos;
+        if (delimiter.size() == 1)
         {
-            token           = s.substr (pos_start, pos_end - pos_start);
-            pos_start       = pos_end + delim_len;
-            res.push_back (token);
+            auto end = s.data() + s.size();
+            auto found = string_find_char(s.data() + pos, end, delimiter[0]);
+            return found == end ? std::string_view::npos : static_cast<size_t>(found - s.data());
         }
-    
-        res.push_back (s.substr (pos_start));
+        return s.find(delimiter, pos);
+    }
 
-        return res;
+    /*!
+    * @brief Lazy range of tokens between delimiters, as views into the source. Same tokens as string_split.
+    * An empty delimiter yields the whole source as one token.
+    */
+    class string_split_range
+    {
+    public:
+        class iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = std::string_view;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const std::string_view*;
+            using reference = std::string_view;
+        private:
+            std::string_view _source;
+            std::string_view _delimiter;
+            size_t _begin = 0;
+            size_t _end = 0;
+            bool _last = true;
+            bool _done = true;
+
+            void _find()
+            {
+                size_t end = _delimiter.empty() ? std::string_view::npos : string_find(_source, _delimiter, _begin);
+                _last = end == std::string_view::npos;
+                _end = _last ? _source.size() : end;
+            }
+        public:
+            iterator() = default;
+            iterator(std::string_view source, std::string_view delimiter) :
+                _source(source), _delimiter(delimiter), _done(false)
+            {
+                _find();
+            }
+
+            std::string_view operator*() const { return _source.substr(_begin, _end - _begin); }
+            iterator& operator++()
+            {
+                if (_last)
+                    _done = true;
+                else
+                {
+                    _begin = _end + _delimiter.size();
+                    _find();
+                }
+                return *this;
+            }
+            iterator operator++(int) { auto it = *this; ++*this; return it; }
+
+            bool operator==(iterator const& rhs) const
+            {
+                return _done == rhs._done && (_done || _begin == rhs._begin);
+            }
+        };
+    private:
+        std::string_view _source;
+        std::string_view _delimiter;
+    public:
+        string_split_range(std::string_view source, std::string_view delimiter) :
+            _source(source), _delimiter(delimiter)
+        {}
+
+        iterator begin() const { return { _source, _delimiter }; }
+        iterator end() const { return {}; }
+    };
+
+    /*!
+    * @brief Tokens of `s` as views. Neither `s` nor `delimiter` are copied, so both must outlive the range.
+    */
+    inline string_split_range string_split_view(std::string_view s, std::string_view delimiter)
+    {
+        return { s, delimiter };
+    }
+
+    /*!
+    * @brief Appends token views to `out`. Reusing `out` between calls keeps splitting allocation-free.
+    * @return number of tokens appended.
+    */
+    template<typename TContainer>
+    inline size_t string_split_to(std::string_view s, std::string_view delimiter, TContainer& out)
+    {
+        size_t n = 0;
+        for (auto token : string_split_view(s, delimiter))
+        {
+            out.push_back(token);
+            ++n;
+        }
+        return n;
     }
 
-    std::list<std::string> string_split_ret_s(const std::string& s, const std::string& delimiter)
+    inline std::list<std::string> string_split(const std::string& str, const std::string& delimiter)
     {
-        size_t pos_start = 0, pos_end, delim_len = delimiter.length();
-        std::string token;
         std::list<std::string> res;
+        for (auto token : string_split_view(str, delimiter))
+            res.emplace_back(token);
+        return res;
+    }
 
-        while ((pos_end = s.find(delimiter, pos_start)) != std::string::npos)
+    inline std::list<std::string> string_split_ret_s(const std::string& s, const std::string& delimiter)
+    {
+        return string_split(s, delimiter);
+    }
+    /*!
+    * @brief string_split with the list nodes and the tokens allocated from `resource`.
+    */
+    inline std::pmr::list<std::pmr::string> string_split(std::string_view str, std::string_view delimiter, std::pmr::memory_resource* resource)
+    {
+        std::pmr::list<std::pmr::string> res { resource };
+        for (auto token : string_split_view(str, delimiter))
+            res.emplace_back(token);
+        return res;
+    }
+
+    /*!
+    * @brief Monotonic arena for the strings of one unit of work, e.g. a request.
+    * The first InlineSize bytes come from the arena object itself, further blocks from the upstream resource.
+    * Deallocation is a no-op; everything is released at once by release() or the destructor.
+    * Not thread-safe.
+    */
+    template<size_t InlineSize = 4096>
+    class basic_string_arena : public std::pmr::monotonic_buffer_resource
+    {
+    private:
+        alignas(std::max_align_t) std::byte _inline[InlineSize];
+    public:
+        explicit basic_string_arena(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()) :
+            std::pmr::monotonic_buffer_resource(_inline, InlineSize, upstream)
+        {}
+        basic_string_arena(const basic_string_arena& rhs) = delete;
+        basic_string_arena& operator=(const basic_string_arena& rhs) = delete;
+
+        std::pmr::string string(std::string_view s = {}) { return std::pmr::string { s, this }; }
+    };
+    using string_arena = basic_string_arena<>;
+
+    /*!
+    * @brief Append-only replacement for stringstream when building text.
+    * Numbers are written with to_chars, so there is no locale and no stream state. The buffer is a std::pmr::string:
+    * constructed over a string_arena, a request builds all of its text without touching the global heap.
+    */
+    class string_builder
+    {
+    private:
+        std::pmr::string _buffer;
+    public:
+        string_builder() = default;
+        explicit string_builder(std::pmr::memory_resource* resource, size_t capacity = 0) :
+            _buffer(resource)
         {
-            token = s.substr(pos_start, pos_end - pos_start);
-            pos_start = pos_end + delim_len;
-            res.push_back(token);
+            _buffer.reserve(capacity);
         }
 
-        res.push_back(s.substr(pos_start));
+        string_builder& append(std::string_view s) { _buffer.append(s); return *this; }
+        string_builder& append(const char* s) { _buffer.append(s); return *this; }
+        string_builder& append(char c) { _buffer.push_back(c); return *this; }
+        string_builder& append(size_t count, char c) { _buffer.append(count, c); return *this; }
+        string_builder& append(bool value) { return append(value ? std::string_view("true") : std::string_view("false")); }
+        template<typename T> requires std::is_arithmetic_v<T>
+        string_builder& append(T value)
+        {
+            char buffer[64];
+            auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+            _buffer.append(buffer, result.ptr);
+            return *this;
+        }
+        template<typename T>
+        string_builder& operator<<(const T& value) { return append(value); }
+        string_builder& operator<<(const std::string& value) { return append(std::string_view(value)); }
+        string_builder& operator<<(const std::pmr::string& value) { return append(std::string_view(value)); }
 
-        if (res.empty())
-            res.push_back(s);
+        /*!
+        * @brief Appends the items of `range` separated by `separator`, each passed through `projection` first.
+        */
+        template<typename TRange, typename TProjection = std::identity>
+        string_builder& append_join(const TRange& range, std::string_view separator, TProjection projection = {})
+        {
+            bool first = true;
+            for (auto& item : range)
+            {
+                if (!first)
+                    append(separator);
+                first = false;
+                *this << std::invoke(projection, item);
+            }
+            return *this;
+        }
 
-        return res;
-    }
+#if defined(UTILITIES_STRING_FORMAT_STD) || defined(UTILITIES_STRING_FORMAT_FMT)
+        template<typename ...TArgs>
+        string_builder& append_fmt(format_string<TArgs...> format, TArgs&&... args)
+        {
+            string_fmt_append(_buffer, format, std::forward<TArgs>(args)...);
+            return *this;
+        }
+#endif
+
+        void reserve(size_t capacity) { _buffer.reserve(capacity); }
+        void clear() { _buffer.clear(); }
+        size_t size() const { return _buffer.size(); }
+        bool empty() const { return _buffer.empty(); }
+
+        std::string_view view() const { return _buffer; }
+        const char* c_str() const { return _buffer.c_str(); }
+        std::string str() const { return std::string(_buffer); }
+        std::pmr::memory_resource* resource() const { return _buffer.get_allocator().resource(); }
+        /*!
+        * @brief Moves the buffer out, it is still allocated from resource().
+        */
+        std::pmr::string release() { return std::move(_buffer); }
+
+        operator std::string_view() const { return view(); }
+    };
 }
 
 #include <thread>
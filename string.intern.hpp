@@ -0,0 +1,211 @@
+#ifndef UTILITIES_STRING_INTERN_HPP
+#define UTILITIES_STRING_INTERN_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <cstring>
+#include <cstddef>
+#include <optional>
+#include <functional>
+
+namespace Utilities
+{
+    struct _interned_entry
+    {
+        size_t Hash;
+        size_t Size;
+        char Data[1];       // Size chars and a terminating '\0'
+    };
+
+    /*!
+    * @brief Handle to a string owned by a string_intern_pool.
+    * Handles from one pool are equal iff their pointers are, the hash is computed once at interning.
+    * The text stays valid for the lifetime of the pool.
+    */
+    class interned_string
+    {
+    private:
+        const _interned_entry* _entry;
+
+        static const _interned_entry* _empty()
+        {
+            static const _interned_entry entry { std::hash<std::string_view>{}({}), 0, { '\0' } };
+            return &entry;
+        }
+    public:
+        interned_string() : _entry(_empty()) {}
+        explicit interned_string(const _interned_entry* entry) : _entry(entry) {}
+
+        std::string_view view() const { return { _entry->Data, _entry->Size }; }
+        const char* c_str() const { return _entry->Data; }
+        const char* data() const { return _entry->Data; }
+        size_t size() const { return _entry->Size; }
+        bool empty() const { return _entry->Size == 0; }
+        size_t hash() const { return _entry->Hash; }
+        std::string str() const { return std::string(view()); }
+
+        operator std::string_view() const { return view(); }
+
+        bool operator==(const interned_string& rhs) const { return _entry == rhs._entry; }
+        bool operator!=(const interned_string& rhs) const { return _entry != rhs._entry; }
+        bool operator<(const interned_string& rhs) const { return view() < rhs.view(); }
+    };
+
+    /*!
+    * @brief Thread-safe interning table.
+    * Looking up a string that is already interned takes no lock: buckets are read through atomics and chains
+    * are never modified after publication. Inserting takes a mutex, growing builds a new table and retires
+    * the old one until the pool is destroyed, so concurrent readers never see freed memory.
+    */
+    class string_intern_pool
+    {
+    private:
+        struct _node
+        {
+            const _interned_entry* Entry;
+            std::atomic<const _node*> Next;
+        };
+        struct _table
+        {
+            size_t Mask;
+            std::unique_ptr<std::atomic<const _node*>[]> Buckets;
+            std::vector<std::unique_ptr<_node>> Nodes;
+
+            explicit _table(size_t buckets) :
+                Mask(buckets - 1), Buckets(new std::atomic<const _node*>[buckets])
+            {
+                for (size_t i = 0; i < buckets; ++i)
+                    Buckets[i].store(nullptr, std::memory_order_relaxed);
+            }
+            // caller holds the pool mutex
+            void link(const _interned_entry* entry)
+            {
+                auto& bucket = Buckets[entry->Hash & Mask];
+                auto& node = Nodes.emplace_back(new _node { entry, {} });
+                node->Next.store(bucket.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                bucket.store(node.get(), std::memory_order_release);
+            }
+            const _interned_entry* find(std::string_view s, size_t hash) const
+            {
+                for (auto node = Buckets[hash & Mask].load(std::memory_order_acquire); node; node = node->Next.load(std::memory_order_acquire))
+                {
+                    auto e = node->Entry;
+                    if (e->Hash == hash && e->Size == s.size() && std::memcmp(e->Data, s.data(), s.size()) == 0)
+                        return e;
+                }
+                return nullptr;
+            }
+        };
+
+        static constexpr size_t _blockSize = 64 * 1024;
+
+        std::atomic<_table*> _current;
+        std::vector<std::unique_ptr<_table>> _tables;       // the current one and every retired one
+        std::vector<std::unique_ptr<char[]>> _blocks;
+        char* _head = nullptr;
+        size_t _left = 0;
+        std::atomic<size_t> _size = 0;
+        std::mutex _mutex;
+
+        // caller holds _mutex
+        _interned_entry* _allocate(size_t bytes)
+        {
+            constexpr size_t align = alignof(_interned_entry);
+            bytes = (bytes + align - 1) & ~(align - 1);
+            if (bytes > _blockSize / 4)
+                return reinterpret_cast<_interned_entry*>(_blocks.emplace_back(new char[bytes]).get());
+            if (bytes > _left)
+            {
+                _head = _blocks.emplace_back(new char[_blockSize]).get();
+                _left = _blockSize;
+            }
+            auto p = _head;
+            _head += bytes;
+            _left -= bytes;
+            return reinterpret_cast<_interned_entry*>(p);
+        }
+        void _grow()
+        {
+            auto current = _current.load(std::memory_order_relaxed);
+            auto& next = _tables.emplace_back(new _table((current->Mask + 1) * 2));
+            for (auto& node : current->Nodes)
+                next->link(node->Entry);
+            _current.store(next.get(), std::memory_order_release);
+        }
+    public:
+        explicit string_intern_pool(size_t buckets = 1024)
+        {
+            size_t n = 16;
+            while (n < buckets)
+                n <<= 1;
+            _current.store(_tables.emplace_back(new _table(n)).get(), std::memory_order_relaxed);
+        }
+        string_intern_pool(const string_intern_pool& rhs) = delete;
+        string_intern_pool& operator=(const string_intern_pool& rhs) = delete;
+
+        /*!
+        * @brief Process-wide pool, e.g. for header names, column names and log keys.
+        */
+        static string_intern_pool& shared()
+        {
+            static string_intern_pool pool;
+            return pool;
+        }
+
+        static size_t hash(std::string_view s) { return std::hash<std::string_view>{}(s); }
+
+        /*!
+        * @brief Lock-free lookup, never inserts.
+        */
+        std::optional<interned_string> find(std::string_view s) const
+        {
+            if (s.empty())
+                return interned_string {};
+            if (auto e = _current.load(std::memory_order_acquire)->find(s, hash(s)))
+                return interned_string { e };
+            return {};
+        }
+
+        interned_string intern(std::string_view s)
+        {
+            if (s.empty())
+                return {};
+            size_t h = hash(s);
+            if (auto e = _current.load(std::memory_order_acquire)->find(s, h))
+                return interned_string { e };
+
+            std::lock_guard lk { _mutex };
+            auto table = _current.load(std::memory_order_relaxed);
+            if (auto e = table->find(s, h))
+                return interned_string { e };
+
+            auto entry = _allocate(offsetof(_interned_entry, Data) + s.size() + 1);
+            entry->Hash = h;
+            entry->Size = s.size();
+            std::memcpy(entry->Data, s.data(), s.size());
+            entry->Data[s.size()] = '\0';
+
+            if (table->Nodes.size() >= table->Mask + 1)
+                _grow();
+            _current.load(std::memory_order_relaxed)->link(entry);
+            _size.fetch_add(1, std::memory_order_relaxed);
+            return interned_string { entry };
+        }
+
+        size_t size() const { return _size.load(std::memory_order_relaxed); }
+    };
+
+    inline interned_string intern(std::string_view s) { return string_intern_pool::shared().intern(s); }
+}
+
+template<>
+struct std::hash<Utilities::interned_string>
+{
+    size_t operator()(const Utilities::interned_string& s) const noexcept { return s.hash(); }
+};
+
+#endif // UTILITIES_STRING_INTERN_HPP
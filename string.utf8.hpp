@@ -0,0 +1,516 @@
+#ifndef UTILITIES_STRING_UTF8_HPP
+#define UTILITIES_STRING_UTF8_HPP
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+#include "exceptions.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define UTILITIES_UTF8_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UTILITIES_UTF8_SSE2
+#endif
+
+namespace Utilities
+{
+    /*
+    * Strict UTF-8 (RFC 3629): overlong forms, surrogates and code points above U+10FFFF are invalid.
+    * Transcoders throw Exceptions::encoding_error with the offset (in input code units) of the first bad sequence.
+    */
+
+    constexpr char32_t utf_replacement_character = 0xFFFD;
+
+    namespace _utf8
+    {
+        inline bool ascii8(const char* p)
+        {
+            uint64_t w;
+            std::memcpy(&w, p, sizeof(w));
+            return (w & 0x8080808080808080ull) == 0;
+        }
+
+        // length of the ASCII prefix of [p, p + n)
+        inline size_t ascii_prefix(const char* p, size_t n)
+        {
+            size_t i = 0;
+#if defined(UTILITIES_UTF8_SSE2)
+            for (; i + 16 <= n; i += 16)
+            {
+                int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)));
+                if (mask != 0)
+                {
+                    while (!(mask & 1)) { mask >>= 1; ++i; }
+                    return i;
+                }
+            }
+#endif
+            for (; i + 8 <= n && ascii8(p + i); i += 8);
+            for (; i < n && static_cast<unsigned char>(p[i]) < 0x80; ++i);
+            return i;
+        }
+
+        /*
+        * Decodes one non-ASCII sequence at p[0].
+        * @return its length, or 0 when it is invalid or truncated.
+        */
+        inline size_t decode(const unsigned char* p, size_t n, char32_t& cp)
+        {
+            unsigned char b0 = p[0];
+            if (b0 < 0x80) { cp = b0; return 1; }
+            if (b0 < 0xC2 || b0 > 0xF4)
+                return 0;
+            if (b0 < 0xE0)
+            {
+                if (n < 2 || (p[1] & 0xC0) != 0x80)
+                    return 0;
+                cp = (char32_t(b0 & 0x1F) << 6) | (p[1] & 0x3F);
+                return 2;
+            }
+            if (n < 2)
+                return 0;
+            unsigned char b1 = p[1];
+            // second-byte ranges exclude overlongs (E0, F0), surrogates (ED) and > U+10FFFF (F4)
+            unsigned char lo = b0 == 0xE0 ? 0xA0 : b0 == 0xF0 ? 0x90 : 0x80;
+            unsigned char hi = b0 == 0xED ? 0x9F : b0 == 0xF4 ? 0x8F : 0xBF;
+            if (b1 < lo || b1 > hi)
+                return 0;
+            if (b0 < 0xF0)
+            {
+                if (n < 3 || (p[2] & 0xC0) != 0x80)
+                    return 0;
+                cp = (char32_t(b0 & 0x0F) << 12) | (char32_t(b1 & 0x3F) << 6) | (p[2] & 0x3F);
+                return 3;
+            }
+            if (n < 4 || (p[2] & 0xC0) != 0x80 || (p[3] & 0xC0) != 0x80)
+                return 0;
+            cp = (char32_t(b0 & 0x07) << 18) | (char32_t(b1 & 0x3F) << 12) | (char32_t(p[2] & 0x3F) << 6) | (p[3] & 0x3F);
+            return 4;
+        }
+
+        // length of the maximal invalid subpart at p[0], which is replaced by a single U+FFFD
+        inline size_t invalid_length(const unsigned char* p, size_t n)
+        {
+            unsigned char b0 = p[0];
+            if (b0 < 0xC2 || b0 > 0xF4)
+                return 1;
+            size_t expected = b0 < 0xE0 ? 2 : b0 < 0xF0 ? 3 : 4;
+            unsigned char lo = b0 == 0xE0 ? 0xA0 : b0 == 0xF0 ? 0x90 : 0x80;
+            unsigned char hi = b0 == 0xED ? 0x9F : b0 == 0xF4 ? 0x8F : 0xBF;
+            size_t i = 1;
+            for (; i < expected && i < n; ++i, lo = 0x80, hi = 0xBF)
+                if (p[i] < lo || p[i] > hi)
+                    break;
+            return i;
+        }
+
+        inline size_t scalar_first_invalid(const char* data, size_t size)
+        {
+            auto p = reinterpret_cast<const unsigned char*>(data);
+            size_t i = 0;
+            while (i < size)
+            {
+                i += ascii_prefix(data + i, size - i);
+                if (i == size)
+                    break;
+                char32_t cp;
+                size_t length = decode(p + i, size - i, cp);
+                if (length == 0)
+                    return i;
+                i += length;
+            }
+            return std::string_view::npos;
+        }
+
+#if defined(UTILITIES_UTF8_AVX2)
+        /*
+        * Lookup validator (Keiser & Lemire, "Validating UTF-8 in less than one instruction per byte"):
+        * three nibble table lookups classify every byte pair, two saturating subtractions find where
+        * the third and fourth bytes of a sequence must be continuations.
+        */
+        class avx2_validator
+        {
+        private:
+            static constexpr uint8_t TOO_SHORT      = 1 << 0;
+            static constexpr uint8_t TOO_LONG       = 1 << 1;
+            static constexpr uint8_t OVERLONG_3     = 1 << 2;
+            static constexpr uint8_t TOO_LARGE      = 1 << 3;
+            static constexpr uint8_t SURROGATE      = 1 << 4;
+            static constexpr uint8_t OVERLONG_2     = 1 << 5;
+            static constexpr uint8_t TOO_LARGE_1000 = 1 << 6;
+            static constexpr uint8_t OVERLONG_4     = 1 << 6;
+            static constexpr uint8_t TWO_CONTS      = 1 << 7;
+            static constexpr uint8_t CARRY          = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+            __m256i _error = _mm256_setzero_si256();
+            __m256i _prev = _mm256_setzero_si256();
+            __m256i _incomplete = _mm256_setzero_si256();
+
+            static __m256i table(
+                uint8_t x0, uint8_t x1, uint8_t x2, uint8_t x3, uint8_t x4, uint8_t x5, uint8_t x6, uint8_t x7,
+                uint8_t x8, uint8_t x9, uint8_t xA, uint8_t xB, uint8_t xC, uint8_t xD, uint8_t xE, uint8_t xF)
+            {
+                return _mm256_setr_epi8(
+                    x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, xA, xB, xC, xD, xE, xF,
+                    x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, xA, xB, xC, xD, xE, xF);
+            }
+            static __m256i high_nibbles(__m256i v) { return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F)); }
+            // input shifted right by N bytes, with the last N bytes of prev shifted in
+            template<int N>
+            static __m256i previous(__m256i input, __m256i prev)
+            {
+                return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - N);
+            }
+
+            static __m256i special_cases(__m256i input, __m256i prev1)
+            {
+                auto byte1High = _mm256_shuffle_epi8(table(
+                    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+                    TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+                    TOO_SHORT | OVERLONG_2,
+                    TOO_SHORT,
+                    TOO_SHORT | OVERLONG_3 | SURROGATE,
+                    TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4
+                ), high_nibbles(prev1));
+                auto byte1Low = _mm256_shuffle_epi8(table(
+                    CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+                    CARRY | OVERLONG_2,
+                    CARRY,
+                    CARRY,
+                    CARRY | TOO_LARGE,
+                    CARRY | TOO_LARGE | TOO_LARGE_1000,
+                    CARRY | TOO_LARGE | TOO_LARGE_1000,
+                    CARRY | TOO_LARGE | TOO_LARGE_1000,
+                    CARRY | TOO_LARGE | TOO_LARGE_1000,
+                    CARRY | TOO_LARGE | TOO_LARGE_1000,
+                    CARRY | TOO_LARGE | TOO_LARGE_1000,
+                    CARRY | TOO_LARGE | TOO_LARGE_1000,
+                    CARRY | TOO_LARGE | TOO_LARGE_1000,
+                    CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+                    CARRY | TOO_LARGE | TOO_LARGE_1000,
+                    CARRY | TOO_LARGE | TOO_LARGE_1000
+                ), _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)));
+                auto byte2High = _mm256_shuffle_epi8(table(
+                    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+                    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+                    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+                    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+                    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+                    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+                ), high_nibbles(input));
+                return _mm256_and_si256(_mm256_and_si256(byte1High, byte1Low), byte2High);
+            }
+
+            static __m256i multibyte_lengths(__m256i input, __m256i prev, __m256i special)
+            {
+                auto prev2 = previous<2>(input, prev);
+                auto prev3 = previous<3>(input, prev);
+                auto third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+                auto fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+                auto must23 = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(static_cast<char>(0x80)));
+                return _mm256_xor_si256(must23, special);
+            }
+
+            // non-zero where the block ends inside a sequence
+            static __m256i incomplete(__m256i input)
+            {
+                const auto max = _mm256_setr_epi8(
+                    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                    static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+                return _mm256_subs_epu8(input, max);
+            }
+        public:
+            void next(__m256i input)
+            {
+                if (_mm256_movemask_epi8(input) == 0)
+                    _error = _mm256_or_si256(_error, _incomplete);
+                else
+                {
+                    auto special = special_cases(input, previous<1>(input, _prev));
+                    _error = _mm256_or_si256(_error, multibyte_lengths(input, _prev, special));
+                    _incomplete = incomplete(input);
+                }
+                _prev = input;
+            }
+            bool valid() const { return _mm256_testz_si256(_error, _error) != 0; }
+
+            static bool validate(const char* data, size_t size)
+            {
+                avx2_validator v;
+                size_t i = 0;
+                for (; i + 32 <= size; i += 32)
+                {
+                    v.next(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+                    // check every 1 KiB so a bad prefix of a big body is rejected early
+                    if ((i & 1023) == 1024 - 32 && !v.valid())
+                        return false;
+                }
+                // the zero padding makes a truncated last sequence fail as TOO_SHORT
+                alignas(32) char tail[32] = {};
+                std::memcpy(tail, data + i, size - i);
+                v.next(_mm256_load_si256(reinterpret_cast<const __m256i*>(tail)));
+                v._error = _mm256_or_si256(v._error, v._incomplete);
+                return v.valid();
+            }
+        };
+#endif
+
+        template<typename TChar>
+        inline void append_utf8(std::string& out, TChar cp)
+        {
+            auto c = static_cast<char32_t>(cp);
+            if (c < 0x80)
+                out.push_back(static_cast<char>(c));
+            else if (c < 0x800)
+            {
+                char b[2] = { static_cast<char>(0xC0 | (c >> 6)), static_cast<char>(0x80 | (c & 0x3F)) };
+                out.append(b, 2);
+            }
+            else if (c < 0x10000)
+            {
+                char b[3] = { static_cast<char>(0xE0 | (c >> 12)), static_cast<char>(0x80 | ((c >> 6) & 0x3F)), static_cast<char>(0x80 | (c & 0x3F)) };
+                out.append(b, 3);
+            }
+            else
+            {
+                char b[4] = {
+                    static_cast<char>(0xF0 | (c >> 18)), static_cast<char>(0x80 | ((c >> 12) & 0x3F)),
+                    static_cast<char>(0x80 | ((c >> 6) & 0x3F)), static_cast<char>(0x80 | (c & 0x3F))
+                };
+                out.append(b, 4);
+            }
+        }
+
+        // widens an ASCII run [p, p + n) into out
+        template<typename TChar>
+        inline void widen_ascii(const char* p, size_t n, std::basic_string<TChar>& out)
+        {
+            size_t base = out.size();
+            out.resize(base + n);
+            TChar* dst = out.data() + base;
+            size_t i = 0;
+#if defined(UTILITIES_UTF8_SSE2)
+            if constexpr (sizeof(TChar) == 2)
+            {
+                const auto zero = _mm_setzero_si128();
+                for (; i + 16 <= n; i += 16)
+                {
+                    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi8(v, zero));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi8(v, zero));
+                }
+            }
+            else if constexpr (sizeof(TChar) == 4)
+            {
+                const auto zero = _mm_setzero_si128();
+                for (; i + 16 <= n; i += 16)
+                {
+                    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+                    auto lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi16(lo, zero));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(lo, zero));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpacklo_epi16(hi, zero));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 12), _mm_unpackhi_epi16(hi, zero));
+                }
+            }
+#endif
+            for (; i < n; ++i)
+                dst[i] = static_cast<TChar>(static_cast<unsigned char>(p[i]));
+        }
+
+        // length of the ASCII prefix of a UTF-16 / UTF-32 string
+        template<typename TChar>
+        inline size_t wide_ascii_prefix(const TChar* p, size_t n)
+        {
+            size_t i = 0;
+#if defined(UTILITIES_UTF8_SSE2)
+            if constexpr (sizeof(TChar) == 2)
+            {
+                const auto mask = _mm_set1_epi16(static_cast<short>(0xFF80));
+                for (; i + 8 <= n; i += 8)
+                {
+                    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+                    if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, mask), _mm_setzero_si128())) != 0xFFFF)
+                        break;
+                }
+            }
+#endif
+            for (; i < n && static_cast<char32_t>(p[i]) < 0x80; ++i);
+            return i;
+        }
+
+        template<typename TChar>
+        inline void narrow_ascii(const TChar* p, size_t n, std::string& out)
+        {
+            size_t base = out.size();
+            out.resize(base + n);
+            char* dst = out.data() + base;
+            size_t i = 0;
+#if defined(UTILITIES_UTF8_SSE2)
+            if constexpr (sizeof(TChar) == 2)
+            {
+                for (; i + 16 <= n; i += 16)
+                {
+                    auto lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+                    auto hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + 8));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+                }
+            }
+#endif
+            for (; i < n; ++i)
+                dst[i] = static_cast<char>(p[i]);
+        }
+
+        // UTF-8 -> UTF-16 (sizeof(TChar) == 2) or UTF-32 (sizeof(TChar) == 4)
+        template<typename TChar>
+        inline std::basic_string<TChar> decode_string(std::string_view s)
+        {
+            std::basic_string<TChar> out;
+            out.reserve(s.size());
+            auto p = reinterpret_cast<const unsigned char*>(s.data());
+            size_t i = 0;
+            while (i < s.size())
+            {
+                size_t ascii = ascii_prefix(s.data() + i, s.size() - i);
+                widen_ascii(s.data() + i, ascii, out);
+                i += ascii;
+                if (i == s.size())
+                    break;
+                char32_t cp;
+                size_t length = decode(p + i, s.size() - i, cp);
+                if (length == 0)
+                    throw construct_error_args(Exceptions::encoding_error, "Invalid UTF-8 sequence at offset " + std::to_string(i), i);
+                if constexpr (sizeof(TChar) == 2)
+                {
+                    if (cp >= 0x10000)
+                    {
+                        cp -= 0x10000;
+                        out.push_back(static_cast<TChar>(0xD800 + (cp >> 10)));
+                        out.push_back(static_cast<TChar>(0xDC00 + (cp & 0x3FF)));
+                    }
+                    else out.push_back(static_cast<TChar>(cp));
+                }
+                else out.push_back(static_cast<TChar>(cp));
+                i += length;
+            }
+            return out;
+        }
+
+        // UTF-16 / UTF-32 -> UTF-8
+        template<typename TChar>
+        inline std::string encode_string(std::basic_string_view<TChar> s)
+        {
+            std::string out;
+            out.reserve(s.size() + s.size() / 2);
+            size_t i = 0;
+            while (i < s.size())
+            {
+                size_t ascii = wide_ascii_prefix(s.data() + i, s.size() - i);
+                narrow_ascii(s.data() + i, ascii, out);
+                i += ascii;
+                if (i == s.size())
+                    break;
+                auto c = static_cast<char32_t>(s[i]);
+                if constexpr (sizeof(TChar) == 2)
+                {
+                    if (c >= 0xD800 && c <= 0xDBFF && i + 1 < s.size() && s[i + 1] >= 0xDC00 && s[i + 1] <= 0xDFFF)
+                    {
+                        c = 0x10000 + ((c - 0xD800) << 10) + (static_cast<char32_t>(s[i + 1]) - 0xDC00);
+                        ++i;
+                    }
+                    else if (c >= 0xD800 && c <= 0xDFFF)
+                        throw construct_error_args(Exceptions::encoding_error, "Unpaired UTF-16 surrogate at offset " + std::to_string(i), i);
+                }
+                else if ((c >= 0xD800 && c <= 0xDFFF) || c > 0x10FFFF)
+                    throw construct_error_args(Exceptions::encoding_error, "Invalid code point at offset " + std::to_string(i), i);
+                append_utf8(out, c);
+                ++i;
+            }
+            return out;
+        }
+    }
+
+    /*!
+    * @brief Offset of the first byte of the first invalid or truncated sequence, npos when s is valid UTF-8.
+    */
+    inline size_t utf8_first_invalid(std::string_view s)
+    {
+        return _utf8::scalar_first_invalid(s.data(), s.size());
+    }
+
+    /*!
+    * @brief Validates the whole string: AVX2 lookup algorithm when available, an ASCII-skipping scalar loop otherwise.
+    */
+    inline bool utf8_validate(std::string_view s)
+    {
+#if defined(UTILITIES_UTF8_AVX2)
+        return _utf8::avx2_validator::validate(s.data(), s.size());
+#else
+        return _utf8::scalar_first_invalid(s.data(), s.size()) == std::string_view::npos;
+#endif
+    }
+
+    /*!
+    * @brief Throws Exceptions::encoding_error unless s is valid UTF-8.
+    */
+    inline void utf8_require_valid(std::string_view s)
+    {
+        if (utf8_validate(s))
+            return;
+        auto offset = utf8_first_invalid(s);
+        throw construct_error_args(Exceptions::encoding_error, "Invalid UTF-8 sequence at offset " + std::to_string(offset), offset);
+    }
+
+    /*!
+    * @brief Copy of s with every maximal invalid subsequence replaced by U+FFFD (WHATWG / Unicode "substitution of maximal subparts").
+    * Valid input is returned unchanged, so it is cheap to call before handing text to nlohmann::json or the logger.
+    */
+    inline std::string utf8_sanitize(std::string_view s)
+    {
+        if (utf8_validate(s))
+            return std::string(s);
+        std::string out;
+        out.reserve(s.size() + 16);
+        auto p = reinterpret_cast<const unsigned char*>(s.data());
+        size_t i = 0;
+        while (i < s.size())
+        {
+            size_t ascii = _utf8::ascii_prefix(s.data() + i, s.size() - i);
+            out.append(s.data() + i, ascii);
+            i += ascii;
+            if (i == s.size())
+                break;
+            char32_t cp;
+            size_t length = _utf8::decode(p + i, s.size() - i, cp);
+            if (length != 0)
+                out.append(s.data() + i, length);
+            else
+            {
+                _utf8::append_utf8(out, utf_replacement_character);
+                length = _utf8::invalid_length(p + i, s.size() - i);
+            }
+            i += length;
+        }
+        return out;
+    }
+
+    inline std::u16string utf8_to_utf16(std::string_view s) { return _utf8::decode_string<char16_t>(s); }
+    inline std::u32string utf8_to_utf32(std::string_view s) { return _utf8::decode_string<char32_t>(s); }
+    inline std::string utf16_to_utf8(std::u16string_view s) { return _utf8::encode_string(s); }
+    inline std::string utf32_to_utf8(std::u32string_view s) { return _utf8::encode_string(s); }
+
+    /*!
+    * @brief wchar_t conversions: UTF-16 on Windows (the TCHAR / *W API side), UTF-32 elsewhere.
+    */
+    inline std::wstring utf8_to_wide(std::string_view s) { return _utf8::decode_string<wchar_t>(s); }
+    inline std::string wide_to_utf8(std::wstring_view s) { return _utf8::encode_string(s); }
+}
+
+#endif // UTILITIES_STRING_UTF8_HPP
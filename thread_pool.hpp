@@ -0,0 +1,99 @@
+#ifndef UTILITIES_THREAD_POOL_HPP
+#define UTILITIES_THREAD_POOL_HPP
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <type_traits>
+#include <condition_variable>
+
+namespace Utilities::Threading
+{
+	/*!
+	* @brief Fixed set of threads draining one shared FIFO of tasks.
+	*/
+	class ThreadPool
+	{
+	public:
+		using task_type = std::function<void()>;
+	private:
+		std::vector<std::thread> _threads;
+		std::deque<task_type> _tasks;
+		std::mutex _mutex;
+		std::condition_variable _cv;
+		bool _terminate = false;
+
+		void _loop()
+		{
+			while (true)
+			{
+				task_type task;
+				{
+					std::unique_lock lk { _mutex };
+					_cv.wait(lk, [&] { return !_tasks.empty() || _terminate; });
+					if (_tasks.empty())
+						return;
+					task = std::move(_tasks.front());
+					_tasks.pop_front();
+				}
+				task();
+			}
+		}
+	public:
+		ThreadPool(size_t threads = std::thread::hardware_concurrency())
+		{
+			if (threads == 0)
+				threads = 1;
+			_threads.reserve(threads);
+			for (size_t i = 0; i < threads; ++i)
+				_threads.emplace_back(&ThreadPool::_loop, this);
+		}
+		ThreadPool(const ThreadPool& rhs) = delete;
+		ThreadPool(ThreadPool&& rhs) = delete;
+		~ThreadPool() { terminate(); }
+
+		size_t size() const { return _threads.size(); }
+
+		void post(task_type task)
+		{
+			{
+				std::lock_guard lk { _mutex };
+				_tasks.push_back(std::move(task));
+			}
+			_cv.notify_one();
+		}
+
+		template<typename TCallable>
+		auto submit(TCallable&& callable) -> std::future<std::invoke_result_t<TCallable>>
+		{
+			using result_type = std::invoke_result_t<TCallable>;
+			// std::function requires a copyable target, packaged_task is move-only
+			auto task = std::make_shared<std::packaged_task<result_type()>>(std::forward<TCallable>(callable));
+			auto future = task->get_future();
+			post([task] { (*task)(); });
+			return future;
+		}
+
+		/*!
+		* @brief Runs the queued tasks to completion and joins the threads.
+		*/
+		void terminate()
+		{
+			{
+				std::lock_guard lk { _mutex };
+				_terminate = true;
+			}
+			_cv.notify_all();
+			for (auto& t : _threads)
+				if (t.joinable())
+					t.join();
+			_threads.clear();
+		}
+	};
+}
+
+#endif //UTILITIES_THREAD_POOL_HPP
@@ -0,0 +1,429 @@
+#ifndef UTILITIES_WORK_STEALING_POOL_HPP
+#define UTILITIES_WORK_STEALING_POOL_HPP
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <future>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <exception>
+#include <utility>
+#include <type_traits>
+
+#include "events.hpp"
+#include "delegate.hpp"
+#include "item_lock.hpp"
+#include "event_count.hpp"
+
+namespace Utilities::Threading
+{
+	/*!
+	* @brief Chase-Lev work-stealing deque of pointers (the C11 formulation by Le, Pop, Cohen and Zappa Nardelli).
+	* The owner thread pushes and takes at the bottom, LIFO; any thread may steal from the top, FIFO.
+	* The ring grows when full; replaced rings are kept until destruction because a thief may still read them.
+	*/
+	template<typename T>
+	class ChaseLevDeque
+	{
+	private:
+		struct _buffer
+		{
+			int64_t Mask;
+			std::unique_ptr<std::atomic<T*>[]> Items;
+
+			explicit _buffer(int64_t size) : Mask(size - 1), Items(new std::atomic<T*>[size]) {}
+			T* get(int64_t i) const { return Items[i & Mask].load(std::memory_order_relaxed); }
+			void put(int64_t i, T* item) { Items[i & Mask].store(item, std::memory_order_relaxed); }
+		};
+
+		alignas(64) std::atomic<int64_t> _top = 0;
+		alignas(64) std::atomic<int64_t> _bottom = 0;
+		std::atomic<_buffer*> _ring;
+		std::vector<std::unique_ptr<_buffer>> _rings;		// owner only
+
+		_buffer* _grow(_buffer* ring, int64_t bottom, int64_t top)
+		{
+			auto& bigger = _rings.emplace_back(std::make_unique<_buffer>((ring->Mask + 1) * 2));
+			for (auto i = top; i < bottom; ++i)
+				bigger->put(i, ring->get(i));
+			_ring.store(bigger.get(), std::memory_order_release);
+			return bigger.get();
+		}
+	public:
+		explicit ChaseLevDeque(int64_t capacity = 256)
+		{
+			int64_t size = 1;
+			while (size < capacity)
+				size <<= 1;
+			_ring.store(_rings.emplace_back(std::make_unique<_buffer>(size)).get(), std::memory_order_relaxed);
+		}
+		ChaseLevDeque(const ChaseLevDeque& rhs) = delete;
+		ChaseLevDeque& operator=(const ChaseLevDeque& rhs) = delete;
+
+		// owner only
+		void push(T* item)
+		{
+			auto b = _bottom.load(std::memory_order_relaxed);
+			auto t = _top.load(std::memory_order_acquire);
+			auto ring = _ring.load(std::memory_order_relaxed);
+			if (b - t > ring->Mask)
+				ring = _grow(ring, b, t);
+			ring->put(b, item);
+			_bottom.store(b + 1, std::memory_order_release);
+		}
+		// owner only
+		T* take()
+		{
+			auto b = _bottom.load(std::memory_order_relaxed) - 1;
+			auto ring = _ring.load(std::memory_order_relaxed);
+			_bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			auto t = _top.load(std::memory_order_relaxed);
+			if (t > b)
+			{
+				_bottom.store(b + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+			auto item = ring->get(b);
+			if (t == b)
+			{
+				// last item, race the thieves for it
+				if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					item = nullptr;
+				_bottom.store(b + 1, std::memory_order_relaxed);
+			}
+			return item;
+		}
+		// any thread; nullptr when empty or when another thread won the race
+		T* steal()
+		{
+			auto t = _top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			auto b = _bottom.load(std::memory_order_acquire);
+			if (t >= b)
+				return nullptr;
+			auto item = _ring.load(std::memory_order_acquire)->get(t);
+			if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				return nullptr;
+			return item;
+		}
+
+		bool empty() const { return _bottom.load(std::memory_order_acquire) <= _top.load(std::memory_order_acquire); }
+		size_t size() const
+		{
+			auto n = _bottom.load(std::memory_order_acquire) - _top.load(std::memory_order_acquire);
+			return n > 0 ? static_cast<size_t>(n) : 0;
+		}
+	};
+
+	/*!
+	* @brief Thread pool where every worker owns a Chase-Lev deque. Tasks posted from a worker go to its own deque and
+	* run LIFO (cache-warm); idle workers steal the oldest task of a random victim, so irregular workloads spread
+	* over all threads without a central queue. Tasks posted from other threads go through a shared injection queue.
+	* Idle workers park on an event count (std::atomic::wait, a futex on Linux); posting wakes one only when
+	* someone sleeps. Unlike Loop there are no phases: a slow task only occupies its own thread.
+	*/
+	class WorkStealingPool
+	{
+	public:
+		using task_type = MoveDelegate<void(), 6 * sizeof(void*)>;
+	private:
+		struct _worker
+		{
+			WorkStealingPool* Pool;
+			size_t Index;
+			ChaseLevDeque<task_type> Deque;
+			uint32_t Random;
+			std::thread Thread;
+
+			_worker(WorkStealingPool* pool, size_t index) :
+				Pool(pool), Index(index), Random(static_cast<uint32_t>(index * 2654435761u + 1))
+			{}
+		};
+
+		std::vector<std::unique_ptr<_worker>> _workers;
+		std::deque<task_type*> _injected;
+		std::mutex _injectedMutex;
+		alignas(64) std::atomic<size_t> _injectedSize = 0;
+		EventCount _idle;
+		alignas(64) std::atomic<int64_t> _pending = 0;		// posted, not yet finished
+		std::atomic<bool> _stop = false;
+
+		static inline thread_local _worker* _current = nullptr;
+
+		task_type* _pop_injected()
+		{
+			if (_injectedSize.load(std::memory_order_acquire) == 0)
+				return nullptr;
+			std::lock_guard lk { _injectedMutex };
+			if (_injected.empty())
+				return nullptr;
+			auto task = _injected.front();
+			_injected.pop_front();
+			_injectedSize.fetch_sub(1, std::memory_order_release);
+			return task;
+		}
+
+		task_type* _steal(_worker& self)
+		{
+			auto n = _workers.size();
+			for (size_t attempt = 0; attempt < n * 2; ++attempt)
+			{
+				// xorshift32
+				self.Random ^= self.Random << 13;
+				self.Random ^= self.Random >> 17;
+				self.Random ^= self.Random << 5;
+				auto& victim = *_workers[self.Random % n];
+				if (&victim == &self)
+					continue;
+				if (auto task = victim.Deque.steal())
+					return task;
+			}
+			return nullptr;
+		}
+
+		task_type* _find(_worker& self)
+		{
+			if (auto task = self.Deque.take())
+				return task;
+			if (auto task = _pop_injected())
+				return task;
+			return _steal(self);
+		}
+
+		bool _has_work() const
+		{
+			if (_injectedSize.load(std::memory_order_seq_cst) > 0)
+				return true;
+			for (auto& w : _workers)
+				if (!w->Deque.empty())
+					return true;
+			return false;
+		}
+
+		void _report(std::exception_ptr error)
+		{
+			try { Errors(error); }
+			catch (...) {}
+		}
+
+		void _run(std::unique_ptr<task_type> task)
+		{
+			try { (*task)(); }
+			catch (...) { _report(std::current_exception()); }
+			task.reset();
+			if (_pending.fetch_sub(1, std::memory_order_seq_cst) == 1)
+			{
+				_pending.notify_all();
+				if (_stop.load(std::memory_order_seq_cst))
+					_idle.notify_all();		// workers kept alive by this task may leave now
+			}
+		}
+
+		void _loop(_worker& self)
+		{
+			_current = &self;
+			while (true)
+			{
+				if (auto task = _find(self))
+				{
+					_run(std::unique_ptr<task_type>(task));
+					continue;
+				}
+
+				auto key = _idle.prepare_wait();
+				if (_has_work())
+				{
+					_idle.cancel_wait();
+					continue;
+				}
+				// a post() that missed _stop has already counted its task; stay until it is queued and run
+				if (_stop.load(std::memory_order_seq_cst) && _pending.load(std::memory_order_seq_cst) == 0)
+				{
+					_idle.cancel_wait();
+					break;
+				}
+				_idle.wait(key);
+			}
+			_current = nullptr;
+		}
+	public:
+		/*!
+		* @brief Raised on the running thread when a posted task throws; the task counts as finished.
+		*/
+		Event<std::exception_ptr> Errors;
+
+		WorkStealingPool(size_t threads = std::thread::hardware_concurrency())
+		{
+			if (threads == 0)
+				threads = 1;
+			_workers.reserve(threads);
+			for (size_t i = 0; i < threads; ++i)
+				_workers.emplace_back(std::make_unique<_worker>(this, i));
+			for (auto& w : _workers)
+				w->Thread = std::thread(&WorkStealingPool::_loop, this, std::ref(*w));
+		}
+		WorkStealingPool(const WorkStealingPool& rhs) = delete;
+		WorkStealingPool(WorkStealingPool&& rhs) = delete;
+		~WorkStealingPool() { terminate(); }
+
+		size_t size() const { return _workers.size(); }
+
+		/*!
+		* @brief Queues a task. Once terminate() has begun, a task posted from outside the pool runs on the calling
+		* thread instead, since the workers may already have exited.
+		*/
+		void post(task_type task)
+		{
+			auto item = new task_type(std::move(task));
+			_pending.fetch_add(1, std::memory_order_seq_cst);
+			auto local = _current && _current->Pool == this;
+			if (!local && _stop.load(std::memory_order_seq_cst))
+			{
+				_run(std::unique_ptr<task_type>(item));
+				return;
+			}
+			if (local)
+				_current->Deque.push(item);
+			else
+			{
+				std::lock_guard lk { _injectedMutex };
+				_injected.push_back(item);
+				_injectedSize.fetch_add(1, std::memory_order_release);
+			}
+			_idle.notify_one();
+		}
+
+		template<typename TCallable>
+		auto submit(TCallable&& callable) -> std::future<std::invoke_result_t<TCallable>>
+		{
+			using result_type = std::invoke_result_t<TCallable>;
+			std::packaged_task<result_type()> task { std::forward<TCallable>(callable) };
+			auto future = task.get_future();
+			post([task = std::move(task)]() mutable { task(); });
+			return future;
+		}
+
+		/*!
+		* @brief Runs one queued task on the calling thread, if there is one. A task that waits for a result of another
+		* task should loop on this instead of blocking, otherwise all threads may end up waiting on queued work.
+		*/
+		bool run_one()
+		{
+			task_type* task;
+			if (_current && _current->Pool == this)
+				task = _find(*_current);
+			else
+			{
+				task = _pop_injected();
+				for (size_t i = 0; !task && i < _workers.size(); ++i)
+					task = _workers[i]->Deque.steal();
+			}
+			if (!task)
+				return false;
+			_run(std::unique_ptr<task_type>(task));
+			return true;
+		}
+
+		/*!
+		* @brief Blocks until every posted task, including the ones they post, has finished. Not from a pool thread.
+		*/
+		void wait_idle()
+		{
+			for (auto pending = _pending.load(std::memory_order_acquire); pending > 0; pending = _pending.load(std::memory_order_acquire))
+				_pending.wait(pending, std::memory_order_acquire);
+		}
+
+		/*!
+		* @brief Runs the queued tasks to completion and joins the threads.
+		*/
+		void terminate()
+		{
+			if (_stop.exchange(true, std::memory_order_seq_cst))
+				return;
+			wait_idle();
+			_idle.notify_all();
+			for (auto& w : _workers)
+				if (w->Thread.joinable())
+					w->Thread.join();
+		}
+
+		template<typename TCallable, typename TBody>
+		class HostedWorker;
+
+		/*!
+		* @brief Runs a Worker-style callable, `callable(body)`, as pool tasks instead of on a dedicated thread.
+		*/
+		template<typename TCallable, typename TBody, typename ...TArgs>
+		std::shared_ptr<HostedWorker<TCallable, TBody>> host(TCallable callable, TArgs&&... bodyArgs)
+		{
+			return std::make_shared<HostedWorker<TCallable, TBody>>(*this, std::move(callable), std::make_shared<TBody>(std::forward<TArgs>(bodyArgs)...));
+		}
+	};
+
+	/*!
+	* @brief Adapter for the callables of Worker: instead of a thread waiting on a condition variable, notify()
+	* schedules one run of callable(body) on the pool. Runs of one hosted worker never overlap; a notify() during a
+	* run schedules exactly one more run, so items queued meanwhile are not missed.
+	*/
+	template<typename TCallable, typename TBody>
+	class WorkStealingPool::HostedWorker : public std::enable_shared_from_this<HostedWorker<TCallable, TBody>>
+	{
+	public:
+		using callable_type = TCallable;
+		using body_type = TBody;
+	private:
+		static constexpr uint32_t _idle = 0;
+		static constexpr uint32_t _scheduled = 1;	// queued or running
+		static constexpr uint32_t _rerun = 2;		// running, notified again
+
+		WorkStealingPool& _pool;
+		callable_type _callable;
+		std::shared_ptr<body_type> _body;
+		std::atomic<uint32_t> _state = _idle;
+
+		void _schedule()
+		{
+			_pool.post([self = this->shared_from_this()] { self->_execute(); });
+		}
+		void _execute()
+		{
+			_callable(*_body);
+			auto state = _scheduled;
+			if (!_state.compare_exchange_strong(state, _idle, std::memory_order_acq_rel))
+			{
+				_state.store(_scheduled, std::memory_order_release);
+				_schedule();
+			}
+		}
+	public:
+		HostedWorker(WorkStealingPool& pool, callable_type callable, std::shared_ptr<body_type> body) :
+			_pool(pool), _callable(std::move(callable)), _body(std::move(body))
+		{}
+
+		body_type& body() { return *_body; }
+		auto obtain_body() { return item_lock<body_type, typename body_type::mutex_type> { *_body, _body->Mutex }; }
+
+		void notify()
+		{
+			auto state = _state.load(std::memory_order_acquire);
+			while (true)
+			{
+				if (state == _rerun)
+					return;
+				auto next = state == _idle ? _scheduled : _rerun;
+				if (_state.compare_exchange_weak(state, next, std::memory_order_acq_rel))
+				{
+					if (next == _scheduled)
+						_schedule();
+					return;
+				}
+			}
+		}
+	};
+}
+
+#endif //UTILITIES_WORK_STEALING_POOL_HPP